@@ -0,0 +1,211 @@
+#include "mini_motorways_env.h"
+
+namespace {
+
+const Position neighbor_offsets[4] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+
+}  // namespace
+
+// FreeTileSet Implementation
+void FreeTileSet::reset(int grid_width, int grid_height) {
+    width = grid_width;
+    tiles.resize(grid_width * grid_height);
+    slot_of.resize(grid_width * grid_height);
+    for (int i = 0; i < grid_width * grid_height; i++) {
+        tiles[i] = i;
+        slot_of[i] = i;
+    }
+}
+
+void FreeTileSet::insert(const Position& pos) {
+    int tile = pos.y * width + pos.x;
+    if (slot_of[tile] >= 0) return;
+    
+    slot_of[tile] = tiles.size();
+    tiles.push_back(tile);
+}
+
+void FreeTileSet::erase(const Position& pos) {
+    int tile = pos.y * width + pos.x;
+    int slot = slot_of[tile];
+    if (slot < 0) return;
+    
+    int last = tiles.back();
+    tiles[slot] = last;
+    slot_of[last] = slot;
+    tiles.pop_back();
+    slot_of[tile] = -1;
+}
+
+Position FreeTileSet::sample(std::mt19937& rng) const {
+    std::uniform_int_distribution<int> slot_dist(0, tiles.size() - 1);
+    int tile = tiles[slot_dist(rng)];
+    return Position(tile % width, tile / width);
+}
+
+// BuildingIndex Implementation
+void BuildingIndex::clear() {
+    for (int c = 0; c < NUM_CAR_COLORS; c++) {
+        house_ids[c].clear();
+        business_ids[c].clear();
+    }
+}
+
+void BuildingIndex::add(int building_id, const Building& building) {
+    int c = static_cast<int>(building.color);
+    if (building.type == TileType::HOUSE) {
+        house_ids[c].push_back(building_id);
+    } else if (building.type == TileType::BUSINESS) {
+        business_ids[c].push_back(building_id);
+    }
+}
+
+// ConnectivityLabels Implementation
+void ConnectivityLabels::reset(int grid_width, int grid_height) {
+    width = grid_width;
+    height = grid_height;
+    stale = false;
+    parent.resize(width * height);
+    for (int i = 0; i < width * height; i++) {
+        parent[i] = i;
+    }
+}
+
+int ConnectivityLabels::find(int tile) {
+    while (parent[tile] != tile) {
+        parent[tile] = parent[parent[tile]];  // Path halving
+        tile = parent[tile];
+    }
+    return tile;
+}
+
+void ConnectivityLabels::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) {
+        parent[std::max(a, b)] = std::min(a, b);
+    }
+}
+
+void ConnectivityLabels::add_tile(const Position& pos, const TileGrid& grid) {
+    if (stale) return;  // The next rebuild picks the tile up
+
+    int tile = pos.y * width + pos.x;
+    for (const auto& offset : neighbor_offsets) {
+        int nx = pos.x + offset.x;
+        int ny = pos.y + offset.y;
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+        if (grid.is_passable(nx, ny)) {
+            unite(tile, ny * width + nx);
+        }
+    }
+}
+
+void ConnectivityLabels::rebuild(const TileGrid& grid) {
+    for (int i = 0; i < width * height; i++) {
+        parent[i] = i;
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (!grid.is_passable(x, y)) continue;
+            if (x + 1 < width && grid.is_passable(x + 1, y)) unite(y * width + x, y * width + x + 1);
+            if (y + 1 < height && grid.is_passable(x, y + 1)) unite(y * width + x, (y + 1) * width + x);
+        }
+    }
+    stale = false;
+}
+
+bool ConnectivityLabels::connected(const Position& a, const Position& b, const TileGrid& grid) {
+    if (stale) rebuild(grid);
+    if (!grid.is_passable(a.x, a.y) || !grid.is_passable(b.x, b.y)) return false;
+    return find(a.y * width + a.x) == find(b.y * width + b.x);
+}
+
+// FlowField Implementation
+void FlowField::reset(int grid_width, int grid_height) {
+    width = grid_width;
+    height = grid_height;
+    stale = false;
+    dist.assign(width * height, UNREACHABLE);
+    nearest.assign(width * height, -1);
+    sources.clear();
+    frontier.clear();
+}
+
+void FlowField::relax(const TileGrid& grid) {
+    // BFS from the frontier; a tile is only revisited when its distance drops
+    for (size_t head = 0; head < frontier.size(); head++) {
+        int tile = frontier[head];
+        int x = tile % width;
+        int y = tile / width;
+        uint16_t next_dist = dist[tile] + 1;
+
+        for (const auto& offset : neighbor_offsets) {
+            int nx = x + offset.x;
+            int ny = y + offset.y;
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+            if (!grid.is_passable(nx, ny)) continue;
+
+            int neighbor = ny * width + nx;
+            if (next_dist < dist[neighbor]) {
+                dist[neighbor] = next_dist;
+                nearest[neighbor] = nearest[tile];
+                frontier.push_back(neighbor);
+            }
+        }
+    }
+    frontier.clear();
+}
+
+void FlowField::rebuild(const TileGrid& grid) {
+    std::fill(dist.begin(), dist.end(), UNREACHABLE);
+    std::fill(nearest.begin(), nearest.end(), -1);
+    for (const auto& [pos, building_id] : sources) {
+        if (!grid.is_passable(pos.x, pos.y)) continue;
+        int tile = pos.y * width + pos.x;
+        dist[tile] = 0;
+        nearest[tile] = building_id;
+        frontier.push_back(tile);
+    }
+    relax(grid);
+    stale = false;
+}
+
+void FlowField::add_source(const Position& pos, int building_id, const TileGrid& grid) {
+    sources.emplace_back(pos, building_id);
+    if (stale) return;
+
+    int tile = pos.y * width + pos.x;
+    dist[tile] = 0;
+    nearest[tile] = building_id;
+    frontier.push_back(tile);
+    relax(grid);
+}
+
+void FlowField::add_tile(const Position& pos, const TileGrid& grid) {
+    if (stale || sources.empty()) return;
+
+    // The new tile takes its best neighbour's distance + 1, then passes it on
+    int tile = pos.y * width + pos.x;
+    for (const auto& offset : neighbor_offsets) {
+        int nx = pos.x + offset.x;
+        int ny = pos.y + offset.y;
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+
+        int neighbor = ny * width + nx;
+        if (dist[neighbor] != UNREACHABLE && dist[neighbor] + 1 < dist[tile]) {
+            dist[tile] = dist[neighbor] + 1;
+            nearest[tile] = nearest[neighbor];
+        }
+    }
+
+    if (dist[tile] != UNREACHABLE) {
+        frontier.push_back(tile);
+        relax(grid);
+    }
+}
+
+int FlowField::nearest_source(const Position& pos, const TileGrid& grid) {
+    if (stale) rebuild(grid);
+    return nearest[pos.y * width + pos.x];
+}
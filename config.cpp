@@ -0,0 +1,188 @@
+#include "mini_motorways_env.h"
+
+namespace {
+
+// Calls visit(key, field) for every Config field, in declaration order
+template <typename C, typename Visitor>
+void for_each_field(C& config, Visitor&& visit) {
+    visit("roads", config.roads);
+    visit("motorways", config.motorways);
+    visit("bridges", config.bridges);
+    visit("roundabouts", config.roundabouts);
+    visit("traffic_lights", config.traffic_lights);
+    visit("upgrades", config.upgrades);
+    visit("initial_colors", config.initial_colors);
+    visit("initial_houses", config.initial_houses);
+    visit("initial_businesses", config.initial_businesses);
+    visit("house_growth_interval", config.house_growth_interval);
+    visit("business_growth_interval", config.business_growth_interval);
+    visit("spawn_interval", config.spawn_interval);
+    visit("spawn_probability", config.spawn_probability);
+    visit("max_cars_per_house", config.max_cars_per_house);
+    visit("max_steps", config.max_steps);
+    visit("congestion_stuck_steps", config.congestion_stuck_steps);
+    visit("game_over_stuck_steps", config.game_over_stuck_steps);
+    visit("max_stuck_cars", config.max_stuck_cars);
+    visit("max_cars_without_resources", config.max_cars_without_resources);
+    visit("traffic_model", config.traffic_model);
+    visit("terminate_on_gridlock", config.terminate_on_gridlock);
+    visit("trip_reward", config.trip_reward);
+    visit("stuck_car_penalty", config.stuck_car_penalty);
+    visit("invalid_action_penalty", config.invalid_action_penalty);
+}
+
+bool parse_value(const std::string& text, int& value) {
+    std::istringstream in(text);
+    return (in >> value) && (in >> std::ws).eof();
+}
+
+bool parse_value(const std::string& text, float& value) {
+    std::istringstream in(text);
+    return (in >> value) && (in >> std::ws).eof();
+}
+
+bool parse_value(const std::string& text, bool& value) {
+    if (text == "true" || text == "1") {
+        value = true;
+    } else if (text == "false" || text == "0") {
+        value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_value(const std::string& text, TrafficModel& value) {
+    if (text == "grid") {
+        value = TrafficModel::GRID_STEP;
+    } else if (text == "nasch") {
+        value = TrafficModel::NAGEL_SCHRECKENBERG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void write_value(std::ostream& out, int value) { out << value; }
+void write_value(std::ostream& out, float value) { out << value; }
+void write_value(std::ostream& out, bool value) { out << (value ? "true" : "false"); }
+void write_value(std::ostream& out, TrafficModel value) {
+    out << (value == TrafficModel::NAGEL_SCHRECKENBERG ? "nasch" : "grid");
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Rules the simulation relies on; returns an empty string when all hold
+std::string check_rules(const Config& config) {
+    int counts[] = {config.roads, config.motorways, config.bridges, config.roundabouts,
+                    config.traffic_lights, config.upgrades, config.initial_houses,
+                    config.initial_businesses, config.max_cars_per_house,
+                    config.congestion_stuck_steps, config.game_over_stuck_steps,
+                    config.max_stuck_cars, config.max_cars_without_resources};
+    for (int count : counts) {
+        if (count < 0) return "counts and thresholds must not be negative";
+    }
+    if (config.initial_colors < 1 || config.initial_colors > NUM_CAR_COLORS) {
+        return "initial_colors must be between 1 and " + std::to_string(NUM_CAR_COLORS);
+    }
+    if (config.initial_houses + config.initial_businesses > MapLayout::MAX_BUILDINGS) {
+        return "at most " + std::to_string(MapLayout::MAX_BUILDINGS) + " initial buildings";
+    }
+    if (config.house_growth_interval < 1 || config.business_growth_interval < 1 ||
+        config.spawn_interval < 1) {
+        return "intervals must be at least 1";
+    }
+    if (config.max_steps < 1) {
+        return "max_steps must be at least 1";
+    }
+    if (!(config.spawn_probability >= 0.0f && config.spawn_probability <= 1.0f)) {
+        return "spawn_probability must be between 0 and 1";
+    }
+    return "";
+}
+
+}  // namespace
+
+bool parse_config(std::istream& in, Config& config, std::string& error) {
+    Config parsed = config;
+    std::string line;
+    int line_number = 0;
+    
+    while (std::getline(in, line)) {
+        line_number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = "line " + std::to_string(line_number) + ": expected key = value";
+            return false;
+        }
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        
+        bool found = false;
+        bool valid = false;
+        for_each_field(parsed, [&](const char* name, auto& field) {
+            if (!found && key == name) {
+                found = true;
+                valid = parse_value(value, field);
+            }
+        });
+        
+        if (!found) {
+            error = "line " + std::to_string(line_number) + ": unknown key '" + key + "'";
+            return false;
+        }
+        if (!valid) {
+            error = "line " + std::to_string(line_number) + ": bad value '" + value + "' for " + key;
+            return false;
+        }
+    }
+    
+    error = check_rules(parsed);
+    if (!error.empty()) {
+        return false;
+    }
+    
+    config = parsed;
+    return true;
+}
+
+bool load_config(const std::string& filepath, Config& config) {
+    std::ifstream in(filepath);
+    if (!in) {
+        std::cerr << "Failed to open scenario file: " << filepath << std::endl;
+        return false;
+    }
+    
+    std::string error;
+    if (!parse_config(in, config, error)) {
+        std::cerr << filepath << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void write_config(std::ostream& out, const Config& config) {
+    for_each_field(config, [&](const char* name, const auto& field) {
+        out << name << " = ";
+        write_value(out, field);
+        out << '\n';
+    });
+}
+
+uint64_t config_hash(const Config& config) {
+    std::ostringstream out;
+    write_config(out, config);
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (unsigned char c : out.str()) {
+        hash = (hash ^ c) * 0x100000001B3ULL;
+    }
+    return hash;
+}
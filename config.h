@@ -0,0 +1,64 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+enum class TrafficModel : int {
+    GRID_STEP = 0,            // Every car moves one tile per step
+    NAGEL_SCHRECKENBERG = 1   // Velocities with acceleration, braking and speed limits
+};
+
+// Game rules for one scenario. Parsed once from a scenario file and then read
+// directly by the simulation, so it is kept flat: plain ints, floats and bools.
+struct Config {
+    // Starting pieces
+    int roads = 20;
+    int motorways = 3;
+    int bridges = 2;
+    int roundabouts = 1;
+    int traffic_lights = 2;
+    int upgrades = 1;
+    
+    // Initial city; house and business i take colour i % initial_colors
+    int initial_colors = 3;
+    int initial_houses = 3;
+    int initial_businesses = 2;
+    int house_growth_interval = 60;
+    int business_growth_interval = 200;
+    
+    // Car spawning
+    int spawn_interval = 5;          // Steps between spawn opportunities
+    float spawn_probability = 0.3f;  // Chance of a car at each opportunity
+    int max_cars_per_house = 5;
+    
+    // Episode end
+    int max_steps = 1000;
+    int congestion_stuck_steps = 10;   // Stuck longer than this adds to the congestion penalty
+    int game_over_stuck_steps = 20;    // Stuck longer than this counts as stuck for game over
+    int max_stuck_cars = 10;           // Game over once more cars than this are stuck
+    int max_cars_without_resources = 15;
+    
+    // Traffic
+    TrafficModel traffic_model = TrafficModel::GRID_STEP;
+    bool terminate_on_gridlock = true;
+    
+    // Per-step reward
+    float trip_reward = 1.0f;              // Per completed trip
+    float stuck_car_penalty = 0.1f;        // Per car stuck longer than congestion_stuck_steps
+    float invalid_action_penalty = 0.1f;   // For a placement or removal that failed
+};
+
+// Scenario files hold one `key = value` per line, where keys are the Config
+// field names; `#` starts a comment. Keys that are not given keep the defaults.
+// Returns false and fills `error` on unknown keys, bad values or broken rules.
+bool parse_config(std::istream& in, Config& config, std::string& error);
+bool load_config(const std::string& filepath, Config& config);
+
+// Write every field in the scenario file format
+void write_config(std::ostream& out, const Config& config);
+// 64-bit FNV-1a hash of write_config()'s output: equal configs hash equal
+uint64_t config_hash(const Config& config);
+
+#endif // CONFIG_H
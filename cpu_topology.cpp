@@ -0,0 +1,109 @@
+#include "cpu_topology.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Parse a kernel CPU list such as "0-3,8-11"
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ranges(text);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // Blank or malformed entry
+        }
+    }
+    return cpus;
+}
+
+}  // namespace
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+std::vector<NumaNode> detect_numa_nodes() {
+    std::vector<int> allowed = allowed_cpus();
+    std::vector<NumaNode> nodes;
+    
+#ifdef __linux__
+    const std::string root = "/sys/devices/system/node/";
+    if (DIR* dir = opendir(root.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+                continue;
+            }
+            std::ifstream list(root + name + "/cpulist");
+            std::string text;
+            std::getline(list, text);
+            
+            NumaNode node;
+            node.id = std::stoi(name.substr(4));
+            for (int cpu : parse_cpu_list(text)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            if (!node.cpus.empty()) nodes.push_back(node);
+        }
+        closedir(dir);
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+#endif
+    
+    if (nodes.empty()) {
+        NumaNode node;
+        node.id = 0;
+        node.cpus = allowed;
+        if (node.cpus.empty()) {
+            // No affinity support: number the hardware threads
+            int count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            for (int cpu = 0; cpu < count; cpu++) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+bool pin_current_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
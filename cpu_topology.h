@@ -0,0 +1,53 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+// Allocator for buffers written by one thread and read by others: blocks start
+// on a cache line and are padded to whole lines, so no two buffers share one
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+    
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(CACHE_LINE_SIZE)));
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(CACHE_LINE_SIZE));
+    }
+    
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+// A NUMA node (socket) and the CPUs of it this process may run on
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+// CPUs this process may run on, in order; empty where affinity is not supported
+std::vector<int> allowed_cpus();
+
+// NUMA nodes with at least one allowed CPU, read from /sys on Linux. Without
+// NUMA information this is a single node 0 holding every allowed CPU.
+std::vector<NumaNode> detect_numa_nodes();
+
+// Bind the calling thread to one CPU; false where that is not possible
+bool pin_current_thread(int cpu);
+
+#endif // CPU_TOPOLOGY_H
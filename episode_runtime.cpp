@@ -0,0 +1,112 @@
+#include "episode_runtime.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+// EpisodeTask Implementation
+std::suspend_always EpisodeTask::promise_type::yield_value(const Transition& transition) {
+    // Held until deliver_transitions() has run the sink
+    runtime->transitions.push_back(transition);
+    runtime->yielded.push_back(std::coroutine_handle<promise_type>::from_promise(*this));
+    return {};
+}
+
+// EpisodeRuntime Implementation
+EpisodeRuntime::EpisodeRuntime(int observation_size, int max_batch, BatchPolicy policy, TransitionSink sink)
+    : observation_size(observation_size), max_batch(std::max(max_batch, 1)), policy(std::move(policy)),
+      sink(std::move(sink)), batches(0), actions_served(0) {
+    batch_observations.resize(static_cast<size_t>(this->max_batch) * observation_size);
+    batch_actions.resize(this->max_batch * 3);
+}
+
+EpisodeRuntime::~EpisodeRuntime() {
+    for (Handle handle : ready) {
+        handle.destroy();
+    }
+    for (const Waiting& entry : waiting) {
+        entry.handle.destroy();
+    }
+    for (Handle handle : yielded) {
+        handle.destroy();
+    }
+    for (Handle handle : finished) {
+        handle.destroy();
+    }
+}
+
+void EpisodeRuntime::ActionAwaiter::await_suspend(std::coroutine_handle<EpisodeTask::promise_type> handle) {
+    // Copied into the batch now, while the episode's data is still in cache
+    size_t slot = runtime.waiting.size();
+    std::memcpy(&runtime.batch_observations[slot * runtime.observation_size], observation,
+                sizeof(float) * runtime.observation_size);
+    runtime.waiting.push_back(Waiting{handle, this});
+}
+
+void EpisodeRuntime::spawn(EpisodeTask task) {
+    Handle handle = task.handle;
+    task.handle = nullptr;
+    handle.promise().runtime = this;
+    ready.push_back(handle);
+}
+
+void EpisodeRuntime::resume(Handle handle) {
+    handle.resume();
+    if (handle.done()) {
+        finished.push_back(handle);
+    }
+}
+
+void EpisodeRuntime::deliver_transitions() {
+    // Episodes that yielded continue only after the sink has read their
+    // transitions, up to their next action request or their end
+    while (!transitions.empty() || !yielded.empty()) {
+        if (!transitions.empty() && sink) {
+            sink(transitions.data(), static_cast<int>(transitions.size()));
+        }
+        transitions.clear();
+        
+        resuming.swap(yielded);
+        for (Handle handle : resuming) {
+            resume(handle);
+        }
+        resuming.clear();
+    }
+    
+    std::exception_ptr exception;
+    for (Handle handle : finished) {
+        if (!exception) exception = handle.promise().exception;
+        handle.destroy();
+    }
+    finished.clear();
+    if (exception) std::rethrow_exception(exception);
+}
+
+void EpisodeRuntime::run() {
+    while (!ready.empty() || !waiting.empty()) {
+        // Run episodes up to their next action request until a batch is full;
+        // one held in co_yield will most likely request an action next
+        while (!ready.empty() && static_cast<int>(waiting.size() + yielded.size()) < max_batch) {
+            Handle handle = ready.front();
+            ready.pop_front();
+            resume(handle);
+        }
+        deliver_transitions();
+        // Episodes that ended left room in the batch
+        if (!ready.empty() && static_cast<int>(waiting.size()) < max_batch) continue;
+        if (waiting.empty()) continue;
+        
+        int count = static_cast<int>(waiting.size());
+        {
+            MM_TRACE_SCOPE("policy_batch", "inference");
+            policy(batch_observations.data(), count, batch_actions.data());
+        }
+        batches++;
+        actions_served += count;
+        
+        for (int i = 0; i < count; i++) {
+            std::copy_n(&batch_actions[i * 3], 3, waiting[i].awaiter->action.begin());
+            ready.push_back(waiting[i].handle);
+        }
+        waiting.clear();
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef EPISODE_RUNTIME_H
+#define EPISODE_RUNTIME_H
+
+#include <array>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <vector>
+
+class EpisodeRuntime;
+
+// One step of an episode, handed to the runtime's sink with co_yield.
+// The observation pointers stay valid until the sink returns: the yielding
+// episode stays suspended until then, so they may point into its locals.
+struct Transition {
+    int episode;
+    const float* observation;
+    std::array<int32_t, 3> action;
+    float reward;
+    const float* next_observation;
+    bool done;
+};
+
+// Coroutine type of an episode: it co_awaits runtime.next_action(observation)
+// for every action and co_yields a Transition after every step. It starts
+// suspended and belongs to the runtime once spawned.
+class EpisodeTask {
+public:
+    struct promise_type {
+        EpisodeRuntime* runtime = nullptr;
+        std::exception_ptr exception;
+        
+        EpisodeTask get_return_object() {
+            return EpisodeTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        // Suspends until the sink has taken the transition
+        std::suspend_always yield_value(const Transition& transition);
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+    
+    friend class EpisodeRuntime;
+    explicit EpisodeTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+public:
+    EpisodeTask(EpisodeTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    EpisodeTask& operator=(EpisodeTask&& other) = delete;
+    EpisodeTask(const EpisodeTask&) = delete;
+    EpisodeTask& operator=(const EpisodeTask&) = delete;
+    ~EpisodeTask() {
+        if (handle) handle.destroy();
+    }
+};
+
+// Interleaves many episode coroutines on the calling thread. Episodes run
+// until they wait for an action; once max_batch are waiting, or none can run
+// any further, the policy scores all of their observations in one call and
+// they resume with their actions. Transitions go to the sink after each round,
+// so learning on them overlaps with the episodes still waiting for the policy.
+// Not thread-safe: run one runtime per thread.
+class EpisodeRuntime {
+public:
+    // Same contract as InferenceServer::BatchKernel: 3 actions per observation
+    using BatchPolicy = std::function<void(const float* observations, int count, int32_t* actions)>;
+    using TransitionSink = std::function<void(const Transition* transitions, int count)>;
+    
+    class ActionAwaiter {
+    private:
+        EpisodeRuntime& runtime;
+        const float* observation;
+        std::array<int32_t, 3> action;
+        
+        friend class EpisodeRuntime;
+
+    public:
+        ActionAwaiter(EpisodeRuntime& runtime, const float* observation)
+            : runtime(runtime), observation(observation), action{} {}
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<EpisodeTask::promise_type> handle);
+        std::array<int32_t, 3> await_resume() const noexcept { return action; }
+    };
+
+private:
+    using Handle = std::coroutine_handle<EpisodeTask::promise_type>;
+    
+    struct Waiting {
+        Handle handle;
+        ActionAwaiter* awaiter;
+    };
+    
+    int observation_size;
+    int max_batch;
+    BatchPolicy policy;
+    TransitionSink sink;
+    
+    std::deque<Handle> ready;
+    std::vector<Waiting> waiting;
+    std::vector<Handle> yielded;    // Suspended in co_yield until the sink has run
+    std::vector<Handle> resuming;
+    std::vector<Handle> finished;
+    std::vector<Transition> transitions;
+    std::vector<float> batch_observations;
+    std::vector<int32_t> batch_actions;
+    
+    int64_t batches;
+    int64_t actions_served;
+    
+    friend struct EpisodeTask::promise_type;
+    void resume(Handle handle);
+    void deliver_transitions();
+
+public:
+    EpisodeRuntime(int observation_size, int max_batch, BatchPolicy policy, TransitionSink sink);
+    ~EpisodeRuntime();
+    
+    EpisodeRuntime(const EpisodeRuntime&) = delete;
+    EpisodeRuntime& operator=(const EpisodeRuntime&) = delete;
+    
+    // Take over an episode; it first runs during run()
+    void spawn(EpisodeTask task);
+    
+    // Suspend the calling episode until the policy has chosen its action
+    ActionAwaiter next_action(const float* observation) { return ActionAwaiter(*this, observation); }
+    
+    // Run every spawned episode to completion. Rethrows the first exception an episode let escape.
+    void run();
+    
+    int64_t get_batches() const { return batches; }
+    int64_t get_actions_served() const { return actions_served; }
+};
+
+#endif // EPISODE_RUNTIME_H
@@ -0,0 +1,37 @@
+#include "mini_motorways_env.h"
+
+// GridlockDetector Implementation
+bool GridlockDetector::on_cycle(Car* car) {
+    uint32_t walk = ++walk_counter;
+    Car* current = car->waiting_for;
+    while (current && current != car && current->wait_mark != walk) {
+        current->wait_mark = walk;
+        current = current->waiting_for;
+    }
+    return current == car;
+}
+
+bool GridlockDetector::update(const std::vector<Car*>& changed_waits) {
+    if (cycle_member && (cycle_member->completed || !on_cycle(cycle_member))) {
+        cycle_member = nullptr;
+    }
+    if (cycle_member) return true;
+    
+    // Stamps above step_base belong to walks made during this update
+    uint32_t step_base = walk_counter;
+    for (Car* start : changed_waits) {
+        uint32_t walk = ++walk_counter;
+        Car* car = start;
+        while (car && car->wait_mark <= step_base) {
+            car->wait_mark = walk;
+            car = car->waiting_for;
+        }
+        
+        // Back on this walk's own trail means a cycle; an older trail was already explored
+        if (car && car->wait_mark == walk) {
+            cycle_member = car;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,86 @@
+#include "histogram.h"
+#include <algorithm>
+#include <iomanip>
+
+// Histogram Implementation
+uint64_t Histogram::bucket_limit(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub_bucket = SUB_BUCKETS + bucket % SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void Histogram::clear() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total_count.store(0, std::memory_order_relaxed);
+    total_sum.store(0, std::memory_order_relaxed);
+    max_value.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        add(buckets[b], other.buckets[b].load(std::memory_order_relaxed));
+    }
+    add(total_count, other.total_count.load(std::memory_order_relaxed));
+    add(total_sum, other.total_sum.load(std::memory_order_relaxed));
+    max_value.store(std::max(max(), other.max()), std::memory_order_relaxed);
+}
+
+double Histogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(total_sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t Histogram::sum_buckets(int first, int last) const {
+    uint64_t sum = 0;
+    for (int b = first; b <= last; b++) {
+        sum += buckets[b].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    // Counts are read one by one while the owner may still be recording, so the
+    // rank comes from the buckets themselves rather than total_count
+    uint64_t counts[NUM_BUCKETS];
+    uint64_t n = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        counts[b] = buckets[b].load(std::memory_order_relaxed);
+        n += counts[b];
+    }
+    if (n == 0) return 0;
+    
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return std::min(bucket_limit(b), max());
+        }
+    }
+    return max();
+}
+
+void Histogram::print(std::ostream& out, const std::string& title, const std::string& unit) const {
+    out << title << ": " << count() << " samples, mean " << mean() << " " << unit
+        << ", p50 " << percentile(50) << ", p99 " << percentile(99) << ", max " << max() << std::endl;
+    
+    // Sub-buckets are summed back into powers of two: 0, 1, 2-3, 4-7, ...
+    uint64_t rows[MAX_BITS + 1];
+    for (int row = 0; row <= MAX_BITS; row++) {
+        uint64_t low = row == 0 ? 0 : uint64_t(1) << (row - 1);
+        uint64_t high = row == 0 ? 0 : (uint64_t(1) << row) - 1;
+        rows[row] = sum_buckets(bucket_of(low), bucket_of(high));
+    }
+    uint64_t largest = std::max(*std::max_element(rows, rows + MAX_BITS + 1), uint64_t(1));
+    for (int row = 0; row <= MAX_BITS; row++) {
+        if (rows[row] == 0) continue;
+        uint64_t low = row == 0 ? 0 : uint64_t(1) << (row - 1);
+        uint64_t high = row == 0 ? 0 : (uint64_t(1) << row) - 1;
+        int bar = static_cast<int>(40 * rows[row] / largest);
+        out << "  " << std::setw(8) << low << " - " << std::setw(8) << high << " "
+            << std::setw(10) << rows[row] << " " << std::string(std::max(bar, 1), '#') << std::endl;
+    }
+}
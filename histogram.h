@@ -0,0 +1,74 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counts of non-negative values, bucketed HDR-style: values below SUB_BUCKETS
+// get a bucket each, and every larger power of two is split into SUB_BUCKETS
+// linear sub-buckets, so a percentile is within 1/SUB_BUCKETS (6%) of the true
+// value. Each histogram has one writing thread; counters are relaxed atomics
+// written with plain load and store, so recording costs a few instructions and
+// can sit on hot paths, and any thread may read or merge a snapshot at any time.
+class Histogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_BITS = 40;  // Larger values are counted in the last bucket
+    static const uint64_t MAX_VALUE = (uint64_t(1) << MAX_BITS) - 1;
+    static const int NUM_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+private:
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+    std::atomic<uint64_t> total_count;
+    std::atomic<uint64_t> total_sum;
+    std::atomic<uint64_t> max_value;
+    
+    // Single-writer increment: no locked instruction needed
+    static void add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    uint64_t sum_buckets(int first, int last) const;
+
+public:
+    Histogram() { clear(); }
+    
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+    
+    // Above SUB_BUCKETS, the SUB_BUCKET_BITS bits after the leading one pick the
+    // sub-bucket of the value's power of two
+    static int bucket_of(uint64_t value) {
+        if (value > MAX_VALUE) value = MAX_VALUE;
+        if (value < SUB_BUCKETS) return static_cast<int>(value);
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+    }
+    // Largest value that falls in a bucket
+    static uint64_t bucket_limit(int bucket);
+    
+    // Only the owning thread may record, merge into or clear a histogram
+    void clear();
+    void record(uint64_t value) {
+        add(buckets[bucket_of(value)], 1);
+        add(total_count, 1);
+        add(total_sum, value);
+        if (value > max_value.load(std::memory_order_relaxed)) {
+            max_value.store(value, std::memory_order_relaxed);
+        }
+    }
+    void merge(const Histogram& other);
+    
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    double mean() const;
+    uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+    // Upper bound of the sub-bucket holding the p-th percentile (p in [0, 100])
+    uint64_t percentile(double p) const;
+    
+    // Summary line plus one bar per non-empty power of two
+    void print(std::ostream& out, const std::string& title, const std::string& unit) const;
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,146 @@
+#include "inference_server.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+// InferenceServer Implementation
+InferenceServer::InferenceServer(int observation_size, int action_size, int max_batch,
+                                 int max_latency_us, BatchKernel kernel)
+    : observation_size(observation_size), action_size(action_size), max_batch(std::max(max_batch, 1)),
+      max_latency(max_latency_us), kernel(std::move(kernel)), stopping(false), scheduler(nullptr),
+      queue_gauge(nullptr),
+      batch_observations(static_cast<size_t>(this->max_batch) * observation_size),
+      batch_actions(static_cast<size_t>(this->max_batch) * action_size) {
+    worker = std::thread(&InferenceServer::serve, this);
+}
+
+InferenceServer::InferenceServer(int observation_size, int action_size, int max_batch,
+                                 int max_latency_us, BatchKernel kernel, TaskScheduler& scheduler)
+    : observation_size(observation_size), action_size(action_size), max_batch(std::max(max_batch, 1)),
+      max_latency(max_latency_us), kernel(std::move(kernel)), stopping(false), scheduler(&scheduler),
+      queue_gauge(nullptr) {}
+
+InferenceServer::~InferenceServer() {
+    stop();
+}
+
+void InferenceServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    arrived.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (scheduler) {
+        scheduler->wait(batch_tasks);
+    }
+}
+
+void InferenceServer::infer(const float* observation, int32_t* action) {
+    Request request;
+    request.observation = observation;
+    request.action = action;
+    request.submitted = std::chrono::steady_clock::now();
+    request.taken = false;
+    request.done = false;
+    
+    MM_TRACE_SCOPE("inference_wait", "inference");
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(&request);
+    if (queue_gauge) queue_gauge->set(static_cast<double>(queue.size()));
+    
+    if (!scheduler) {
+        // The worker only needs waking for the first request of a batch or a full one
+        if (queue.size() == 1 || static_cast<int>(queue.size()) == max_batch) {
+            arrived.notify_one();
+        }
+        request.answered.wait(lock, [&request]() { return request.done; });
+        return;
+    }
+    
+    // A request that fills a batch sends it; one still queued at its deadline
+    // sends whatever has gathered ahead of it
+    if (static_cast<int>(queue.size()) % max_batch == 0) {
+        submit_batch();
+    }
+    auto deadline = request.submitted + max_latency;
+    while (!request.done) {
+        if (request.taken) {
+            request.answered.wait(lock, [&request]() { return request.done; });
+        } else if (request.answered.wait_until(lock, deadline) == std::cv_status::timeout && !request.taken) {
+            submit_batch();
+            deadline += max_latency;
+        }
+    }
+}
+
+void InferenceServer::submit_batch() {
+    scheduler->submit([this]() {
+        // Batches may run on several workers at once, each in its own buffers
+        thread_local std::vector<Request*> batch;
+        thread_local std::vector<float> observations;
+        thread_local std::vector<int32_t> actions;
+        std::unique_lock<std::mutex> lock(mutex);
+        run_batch(lock, batch, observations, actions);
+    }, TaskScheduler::HIGH, &batch_tasks);
+}
+
+void InferenceServer::serve() {
+    std::vector<Request*> batch;
+    batch.reserve(max_batch);
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        arrived.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty()) break;  // Stopping with nothing left
+        
+        // Hold the batch open until it is full or its oldest request is due
+        {
+            MM_TRACE_SCOPE("batch_fill", "inference");
+            auto deadline = queue.front()->submitted + max_latency;
+            while (!stopping && static_cast<int>(queue.size()) < max_batch &&
+                   arrived.wait_until(lock, deadline) != std::cv_status::timeout) {
+            }
+        }
+        run_batch(lock, batch, batch_observations, batch_actions);
+    }
+}
+
+void InferenceServer::run_batch(std::unique_lock<std::mutex>& lock, std::vector<Request*>& batch,
+                                std::vector<float>& observations, std::vector<int32_t>& actions) {
+    int count = std::min(static_cast<int>(queue.size()), max_batch);
+    if (count == 0) return;  // Taken by the batches ahead of this one
+    batch.assign(queue.begin(), queue.begin() + count);
+    queue.erase(queue.begin(), queue.begin() + count);
+    for (Request* request : batch) {
+        request->taken = true;
+    }
+    if (queue_gauge) queue_gauge->set(static_cast<double>(queue.size()));
+    lock.unlock();
+    
+    observations.resize(static_cast<size_t>(max_batch) * observation_size);
+    actions.resize(static_cast<size_t>(max_batch) * action_size);
+    for (int i = 0; i < count; i++) {
+        std::memcpy(&observations[static_cast<size_t>(i) * observation_size],
+                    batch[i]->observation, sizeof(float) * observation_size);
+    }
+    {
+        MM_TRACE_SCOPE("inference_batch", "inference");
+        kernel(observations.data(), count, actions.data());
+    }
+    auto answered = std::chrono::steady_clock::now();
+    
+    lock.lock();
+    batch_sizes.record(count);
+    for (int i = 0; i < count; i++) {
+        latencies_us.record(std::chrono::duration_cast<std::chrono::microseconds>(
+            answered - batch[i]->submitted).count());
+        std::memcpy(batch[i]->action, &actions[static_cast<size_t>(i) * action_size],
+                    sizeof(int32_t) * action_size);
+        batch[i]->done = true;
+        batch[i]->answered.notify_one();
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include "histogram.h"
+#include "task_scheduler.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class MetricGauge;
+
+// Gathers single-observation requests from many actor threads into batches
+// for one policy call. A batch closes when it holds max_batch requests or its
+// oldest request has waited max_latency_us, whichever comes first.
+//
+// Batches run on a thread of the server's own, or as HIGH tasks of a shared
+// TaskScheduler, so inference and env stepping use one pool of cores. In the
+// scheduler mode a full batch is queued by the request that fills it and a late
+// one by the waiting request whose deadline passes first. infer() blocks, so it
+// must not be called from a worker of that scheduler.
+class InferenceServer {
+public:
+    // Fills actions[i * action_size ...] for observations[i * observation_size ...], i < count
+    using BatchKernel = std::function<void(const float* observations, int count, int32_t* actions)>;
+
+private:
+    // Lives on the caller's stack for the duration of infer()
+    struct Request {
+        const float* observation;
+        int32_t* action;
+        std::chrono::steady_clock::time_point submitted;
+        bool taken;  // By a batch
+        bool done;
+        std::condition_variable answered;
+    };
+    
+    int observation_size;
+    int action_size;
+    int max_batch;
+    std::chrono::microseconds max_latency;
+    BatchKernel kernel;
+    
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::deque<Request*> queue;
+    bool stopping;
+    std::thread worker;
+    TaskScheduler* scheduler;  // Not owned; null when batches run on `worker`
+    TaskScheduler::TaskGroup batch_tasks;
+    MetricGauge* queue_gauge;  // Set to the queue length under the lock; not owned
+    
+    // Only touched by the worker thread until stop()
+    std::vector<float> batch_observations;
+    std::vector<int32_t> batch_actions;
+    // Recorded under the lock, since scheduler batches may run concurrently
+    Histogram batch_sizes;
+    Histogram latencies_us;
+    
+    void serve();
+    void submit_batch();
+    // Take up to max_batch requests, answer them and return with the lock held again
+    void run_batch(std::unique_lock<std::mutex>& lock, std::vector<Request*>& batch,
+                   std::vector<float>& observations, std::vector<int32_t>& actions);
+
+public:
+    InferenceServer(int observation_size, int action_size, int max_batch, int max_latency_us,
+                    BatchKernel kernel);
+    InferenceServer(int observation_size, int action_size, int max_batch, int max_latency_us,
+                    BatchKernel kernel, TaskScheduler& scheduler);
+    ~InferenceServer();
+    
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+    
+    // Block until the policy has answered this observation; thread-safe
+    void infer(const float* observation, int32_t* action);
+    
+    // Finish queued requests and stop the worker (or wait for the batch tasks);
+    // histograms are final afterwards
+    void stop();
+    
+    // Keep a gauge at the number of waiting requests (null to stop); set before any infer()
+    void set_queue_gauge(MetricGauge* gauge) { queue_gauge = gauge; }
+    
+    const Histogram& get_batch_sizes() const { return batch_sizes; }
+    const Histogram& get_latencies_us() const { return latencies_us; }  // Submit to answer, in us
+};
+
+#endif // INFERENCE_SERVER_H
@@ -0,0 +1,169 @@
+#include "mini_motorways_env.h"
+
+namespace {
+
+// Approach index for a car entering `pos` from the adjacent tile `from`
+int approach_from(const Position& pos, const Position& from) {
+    if (from.y < pos.y) return 0;  // North
+    if (from.x > pos.x) return 1;  // East
+    if (from.y > pos.y) return 2;  // South
+    return 3;                      // West
+}
+
+}  // namespace
+
+// IntersectionModel Implementation
+void IntersectionModel::reset(int grid_width, int grid_height) {
+    width = grid_width;
+    intersections.clear();
+    id_at.assign(grid_width * grid_height, -1);
+    active_ids.clear();
+    for (auto& slot : phase_wheel) {
+        slot.clear();
+    }
+}
+
+void IntersectionModel::add(const Position& pos, TileType type, int current_step) {
+    int& id = id_at[pos.y * width + pos.x];
+    if (id >= 0) {
+        remove(pos);
+    }
+    
+    Intersection intersection;
+    intersection.pos = pos;
+    intersection.type = type;
+    intersection.alive = true;
+    intersection.active = false;
+    intersection.green_axis = 0;
+    intersection.next_approach = 0;
+    for (auto& queue : intersection.queues) {
+        queue.head = 0;
+        queue.count = 0;
+    }
+    
+    id = intersections.size();
+    intersections.push_back(intersection);
+    
+    // Each light switches every LIGHT_PHASE_STEPS, offset by when it was placed
+    if (type == TileType::TRAFFIC_LIGHT) {
+        phase_wheel[current_step % LIGHT_PHASE_STEPS].push_back(id);
+    }
+}
+
+void IntersectionModel::remove(const Position& pos) {
+    int& id = id_at[pos.y * width + pos.x];
+    if (id < 0) return;
+    
+    // Queued cars go back to plain movement; stale wheel and active entries are skipped later
+    Intersection& intersection = intersections[id];
+    for (auto& queue : intersection.queues) {
+        Car* car;
+        while (pop(queue, car)) {
+            car->queued_at_intersection = false;
+        }
+    }
+    intersection.alive = false;
+    intersection.active = false;
+    id = -1;
+}
+
+bool IntersectionModel::request_entry(const Position& pos, const Position& from, Car* car) {
+    if (car->queued_at_intersection) return true;
+    
+    int id = id_at[pos.y * width + pos.x];
+    Intersection& intersection = intersections[id];
+    ApproachQueue& queue = intersection.queues[approach_from(pos, from)];
+    if (queue.count == QUEUE_CAPACITY) return false;
+    
+    queue.cars[(queue.head + queue.count) % QUEUE_CAPACITY] = car;
+    queue.count++;
+    car->queued_at_intersection = true;
+    
+    if (!intersection.active) {
+        intersection.active = true;
+        active_ids.push_back(id);
+    }
+    return true;
+}
+
+bool IntersectionModel::pop(ApproachQueue& queue, Car*& car) {
+    if (queue.count == 0) return false;
+    
+    car = queue.cars[queue.head];
+    queue.head = (queue.head + 1) % QUEUE_CAPACITY;
+    queue.count--;
+    return true;
+}
+
+int IntersectionModel::admit_traffic_light(Intersection& intersection) {
+    // Both approaches on the green axis let their front car through
+    int admitted = 0;
+    for (int approach = intersection.green_axis; approach < APPROACHES; approach += 2) {
+        Car* car;
+        if (pop(intersection.queues[approach], car)) {
+            car->queued_at_intersection = false;
+            car->intersection_clear = true;
+            admitted++;
+        }
+    }
+    return admitted;
+}
+
+int IntersectionModel::admit_roundabout(Intersection& intersection) {
+    // At most two entries per step, never from adjacent approaches
+    bool entered[APPROACHES] = {false, false, false, false};
+    int admitted = 0;
+    
+    for (int k = 0; k < APPROACHES && admitted < 2; k++) {
+        int approach = (intersection.next_approach + k) % APPROACHES;
+        int left = (approach + APPROACHES - 1) % APPROACHES;
+        if (entered[left]) continue;
+        
+        Car* car;
+        if (pop(intersection.queues[approach], car)) {
+            car->queued_at_intersection = false;
+            car->intersection_clear = true;
+            entered[approach] = true;
+            admitted++;
+        }
+    }
+    intersection.next_approach = (intersection.next_approach + 1) % APPROACHES;
+    return admitted;
+}
+
+void IntersectionModel::update(int current_step) {
+    // Switch the lights whose phase ends on this step of the wheel
+    auto& slot = phase_wheel[current_step % LIGHT_PHASE_STEPS];
+    size_t kept = 0;
+    for (int id : slot) {
+        Intersection& intersection = intersections[id];
+        if (!intersection.alive) continue;
+        intersection.green_axis ^= 1;
+        slot[kept++] = id;
+    }
+    slot.resize(kept);
+    
+    // Admit from queues, dropping intersections that have drained
+    kept = 0;
+    for (int id : active_ids) {
+        Intersection& intersection = intersections[id];
+        if (!intersection.alive) continue;
+        
+        if (intersection.type == TileType::TRAFFIC_LIGHT) {
+            admit_traffic_light(intersection);
+        } else {
+            admit_roundabout(intersection);
+        }
+        
+        bool queued = false;
+        for (const auto& queue : intersection.queues) {
+            queued = queued || queue.count > 0;
+        }
+        if (queued) {
+            active_ids[kept++] = id;
+        } else {
+            intersection.active = false;
+        }
+    }
+    active_ids.resize(kept);
+}
@@ -0,0 +1,47 @@
+#include "latency_stats.h"
+#include <algorithm>
+#include <iomanip>
+
+// LatencyStats Implementation
+void LatencyStats::merge(const LatencyStats& other) {
+    for (int op = 0; op < NUM_OPS; op++) {
+        histograms[op].merge(other.histograms[op]);
+    }
+}
+
+void LatencyStats::clear() {
+    for (auto& histogram : histograms) {
+        histogram.clear();
+    }
+}
+
+void LatencyStats::print(std::ostream& out) const {
+    out << "Latency (us):" << std::endl;
+    out << std::left << std::setw(13) << "operation" << std::right << std::setw(12) << "count"
+        << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+    
+    out << std::fixed << std::setprecision(2);
+    for (int op = 0; op < NUM_OPS; op++) {
+        const Histogram& histogram = histograms[op];
+        if (histogram.count() == 0) continue;
+        out << std::left << std::setw(13) << op_name(static_cast<LatencyOp>(op)) << std::right
+            << std::setw(12) << histogram.count()
+            << std::setw(10) << histogram.mean() / 1000.0
+            << std::setw(10) << histogram.percentile(50) / 1000.0
+            << std::setw(10) << histogram.percentile(99) / 1000.0
+            << std::setw(10) << histogram.percentile(99.9) / 1000.0
+            << std::setw(10) << histogram.max() / 1000.0 << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+const char* LatencyStats::op_name(LatencyOp op) {
+    switch (op) {
+        case LatencyOp::STEP: return "step";
+        case LatencyOp::RESET: return "reset";
+        case LatencyOp::FIND_PATH: return "find_path";
+        case LatencyOp::OBSERVATION: return "observation";
+        default: return "unknown";
+    }
+}
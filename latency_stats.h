@@ -0,0 +1,61 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include "histogram.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// What LatencyStats times
+enum class LatencyOp {
+    STEP,         // advance(), without the observation
+    RESET,        // reset() and reset_to_map(), without the observation
+    FIND_PATH,    // One find_path() call
+    OBSERVATION,  // write_observation()
+    COUNT
+};
+
+// One histogram per operation. Give each thread (or each env) its own and
+// merge them for a report.
+class LatencyStats {
+public:
+    static const int NUM_OPS = static_cast<int>(LatencyOp::COUNT);
+
+private:
+    Histogram histograms[NUM_OPS];  // Nanoseconds
+
+public:
+    void record(LatencyOp op, uint64_t nanoseconds) { histograms[static_cast<int>(op)].record(nanoseconds); }
+    void merge(const LatencyStats& other);
+    void clear();
+    const Histogram& get(LatencyOp op) const { return histograms[static_cast<int>(op)]; }
+    
+    // count, mean, p50, p99, p99.9 and max per operation, in microseconds
+    void print(std::ostream& out) const;
+    
+    static const char* op_name(LatencyOp op);
+};
+
+// Times one operation for the lifetime of the scope; null stats cost one branch
+class LatencyTimer {
+private:
+    LatencyStats* stats;
+    LatencyOp op;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    LatencyTimer(LatencyStats* stats, LatencyOp op) : stats(stats), op(op) {
+        if (stats) start = std::chrono::steady_clock::now();
+    }
+    ~LatencyTimer() {
+        if (stats) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stats->record(op, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+    
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
+
+#endif // LATENCY_STATS_H
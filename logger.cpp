@@ -0,0 +1,267 @@
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class SlotKind : uint8_t { TEXT, RECORD };
+
+// Fixed-size messages, so pushing never allocates; longer text is cut short
+struct LogSlot {
+    static const int TEXT_SIZE = 500;
+    
+    SlotKind kind;
+    LogLevel level;
+    uint16_t length;
+    char text[TEXT_SIZE];
+};
+
+// Bounded single-producer, single-consumer ring: the owning thread pushes,
+// the writer pops. Head and tail sit on their own cache lines.
+class LogQueue {
+public:
+    static const uint64_t CAPACITY = 1024;
+    
+private:
+    std::unique_ptr<LogSlot[]> slots;
+    alignas(64) std::atomic<uint64_t> head;  // Next slot to fill; written by the producer
+    alignas(64) std::atomic<uint64_t> tail;  // Next slot to read; written by the writer
+    std::atomic<uint64_t> dropped;
+    
+public:
+    LogQueue() : slots(new LogSlot[CAPACITY]), head(0), tail(0), dropped(0) {}
+    
+    void push(SlotKind kind, LogLevel level, const char* text, size_t length) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        LogSlot& slot = slots[h % CAPACITY];
+        slot.kind = kind;
+        slot.level = level;
+        slot.length = static_cast<uint16_t>(std::min<size_t>(length, LogSlot::TEXT_SIZE));
+        std::memcpy(slot.text, text, slot.length);
+        head.store(h + 1, std::memory_order_release);
+    }
+    
+    // Hand every published message to consume(); returns how many there were
+    template <typename Consume>
+    uint64_t drain(Consume&& consume) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (uint64_t i = t; i < h; i++) {
+            consume(slots[i % CAPACITY]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+    
+    uint64_t get_dropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<LogQueue>> registry;  // Kept after their threads exit
+thread_local LogQueue* local_queue = nullptr;
+
+std::atomic<bool> running(false);
+std::atomic<bool> stopping(false);
+std::thread writer;
+FILE* jsonl_file = nullptr;
+std::mutex direct_mutex;  // Serializes writes while no writer runs
+
+// Stream buffer over a fixed array: characters that do not fit are refused,
+// which leaves the stream failed until the next reset()
+class LineBuffer : public std::streambuf {
+private:
+    char data[LogSlot::TEXT_SIZE];
+
+public:
+    LineBuffer() { reset(); }
+    
+    void reset() { setp(data, data + sizeof(data)); }
+    const char* text() const { return pbase(); }
+    size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+};
+
+struct LineStream {
+    LineBuffer buffer;
+    std::ostream stream;
+    
+    LineStream() : stream(&buffer) {}
+};
+
+thread_local LineStream line_stream;
+
+LogQueue& thread_queue() {
+    if (!local_queue) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_unique<LogQueue>());
+        local_queue = registry.back().get();
+    }
+    return *local_queue;
+}
+
+const char* level_prefix(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return "debug: ";
+        case LogLevel::WARN: return "warning: ";
+        case LogLevel::ERROR: return "error: ";
+        default: return "";
+    }
+}
+
+void append_message(std::string& out, LogLevel level, const char* text, size_t length) {
+    out += level_prefix(level);
+    out.append(text, length);
+    out += '\n';
+}
+
+// One pass over every queue; false when there was nothing to write
+bool drain_queues(std::string& out, std::string& err, std::string& records) {
+    std::vector<LogQueue*> queues;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& queue : registry) {
+            queues.push_back(queue.get());
+        }
+    }
+    
+    uint64_t drained = 0;
+    for (LogQueue* queue : queues) {
+        drained += queue->drain([&](const LogSlot& slot) {
+            if (slot.kind == SlotKind::RECORD) {
+                records.append(slot.text, slot.length);
+                records += '\n';
+            } else {
+                append_message(slot.level >= LogLevel::WARN ? err : out, slot.level, slot.text, slot.length);
+            }
+        });
+    }
+    if (drained == 0) return false;
+    
+    // Everything gathered in this pass goes out in one write per stream
+    if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+        out.clear();
+    }
+    if (!err.empty()) {
+        std::fwrite(err.data(), 1, err.size(), stderr);
+        err.clear();
+    }
+    if (!records.empty()) {
+        if (jsonl_file) {
+            std::fwrite(records.data(), 1, records.size(), jsonl_file);
+        }
+        records.clear();
+    }
+    return true;
+}
+
+void run_writer() {
+    std::string out;
+    std::string err;
+    std::string records;
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (!drain_queues(out, err, records)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    while (drain_queues(out, err, records)) {
+    }
+}
+
+}  // namespace
+
+bool log_start(const std::string& jsonl_path) {
+    log_stop();
+    if (!jsonl_path.empty()) {
+        jsonl_file = std::fopen(jsonl_path.c_str(), "w");
+        if (!jsonl_file) {
+            std::cerr << "Failed to open log file: " << jsonl_path << std::endl;
+            return false;
+        }
+    }
+    std::cout.flush();  // Anything printed before starting comes first
+    stopping.store(false);
+    writer = std::thread(run_writer);
+    running.store(true, std::memory_order_release);
+    return true;
+}
+
+void log_stop() {
+    if (!writer.joinable()) return;
+    
+    // Messages pushed after the final drain has begun may be lost, so stop
+    // only once the logging threads are done
+    running.store(false, std::memory_order_release);
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& queue : registry) {
+            dropped += queue->get_dropped();
+        }
+    }
+    if (dropped > 0) {
+        std::cerr << "Log queues were full: " << dropped << " messages dropped" << std::endl;
+    }
+    if (jsonl_file) {
+        std::fclose(jsonl_file);
+        jsonl_file = nullptr;
+    }
+}
+
+void log_write(LogLevel level, const std::string& text) {
+    log_write(level, text.data(), text.size());
+}
+
+void log_write(LogLevel level, const char* text, size_t length) {
+    if (running.load(std::memory_order_acquire)) {
+        thread_queue().push(SlotKind::TEXT, level, text, length);
+        return;
+    }
+    
+    std::string line;
+    append_message(line, level, text, length);
+    std::lock_guard<std::mutex> lock(direct_mutex);
+    (level >= LogLevel::WARN ? std::cerr : std::cout) << line;
+}
+
+std::ostream& log_line_begin() {
+    line_stream.buffer.reset();
+    line_stream.stream.clear();
+    return line_stream.stream;
+}
+
+void log_line_end(LogLevel level) {
+    log_write(level, line_stream.buffer.text(), line_stream.buffer.length());
+}
+
+void log_episode(const EpisodeRecord& record) {
+    if (!running.load(std::memory_order_acquire) || !jsonl_file) return;
+    
+    char line[LogSlot::TEXT_SIZE];
+    int length = std::snprintf(line, sizeof(line),
+                               "{\"episode\":%d,\"score\":%d,\"steps\":%d,\"total_reward\":%.6g,"
+                               "\"termination\":\"%s\",\"seconds\":%.6g}",
+                               record.episode, record.score, record.steps, record.total_reward,
+                               record.termination, record.seconds);
+    if (length > 0 && length < static_cast<int>(sizeof(line))) {
+        thread_queue().push(SlotKind::RECORD, LogLevel::INFO, line, static_cast<size_t>(length));
+    }
+}
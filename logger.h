@@ -0,0 +1,79 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Asynchronous logging for training loops. Each thread appends to its own
+// bounded single-producer queue without locks or I/O; one background thread
+// drains every queue, writing text lines to stdout and structured records to a
+// JSONL file in large buffered writes. A full queue drops the message (the
+// count is reported at log_stop()), so a loop never waits for the terminal or
+// the disk, however much it logs.
+//
+// Levels below MM_LOG_LEVEL (0 debug, 1 info, 2 warn, 3 error) are compiled
+// out: their MM_LOG_* statements expand to nothing, arguments included.
+// Before log_start() and after log_stop(), messages are written directly.
+enum class LogLevel { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3 };
+
+#ifndef MM_LOG_LEVEL
+#define MM_LOG_LEVEL 1
+#endif
+
+// Stream-style arguments: MM_LOG_INFO("Episode " << episode << " - Score: " << score).
+// The message is formatted into a fixed per-thread buffer and copied into the
+// queue, so a call allocates nothing; text past the slot size is cut short.
+#define MM_LOG_AT(level, message) \
+    do { \
+        std::ostream& mm_log_stream = log_line_begin(); \
+        mm_log_stream << message; \
+        log_line_end(level); \
+    } while (0)
+
+#if MM_LOG_LEVEL <= 0
+#define MM_LOG_DEBUG(message) MM_LOG_AT(LogLevel::DEBUG, message)
+#else
+#define MM_LOG_DEBUG(message) ((void)0)
+#endif
+#if MM_LOG_LEVEL <= 1
+#define MM_LOG_INFO(message) MM_LOG_AT(LogLevel::INFO, message)
+#else
+#define MM_LOG_INFO(message) ((void)0)
+#endif
+#if MM_LOG_LEVEL <= 2
+#define MM_LOG_WARN(message) MM_LOG_AT(LogLevel::WARN, message)
+#else
+#define MM_LOG_WARN(message) ((void)0)
+#endif
+#if MM_LOG_LEVEL <= 3
+#define MM_LOG_ERROR(message) MM_LOG_AT(LogLevel::ERROR, message)
+#else
+#define MM_LOG_ERROR(message) ((void)0)
+#endif
+
+// One finished episode, as a line of the JSONL file
+struct EpisodeRecord {
+    int episode;
+    int score;
+    int steps;
+    double total_reward;
+    const char* termination;  // A string literal
+    double seconds;
+};
+
+// Start the writer; records go to jsonl_path (none when empty)
+bool log_start(const std::string& jsonl_path = "");
+// Drain every queue, then stop the writer
+void log_stop();
+
+// Prefer the MM_LOG_* macros, which compile out below MM_LOG_LEVEL
+void log_write(LogLevel level, const std::string& text);
+void log_write(LogLevel level, const char* text, size_t length);
+// This thread's line buffer, emptied; log_line_end() writes what was streamed into it
+std::ostream& log_line_begin();
+void log_line_end(LogLevel level);
+// Dropped without a JSONL file
+void log_episode(const EpisodeRecord& record);
+
+#endif // LOGGER_H
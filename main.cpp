@@ -1,12 +1,34 @@
 #include "mini_motorways_env.h"
+#include "vector_env.h"
+#include "shm_channel.h"
+#include "rollout.h"
+#include "process_pool.h"
+#include "inference_server.h"
+#include "task_scheduler.h"
+#include "episode_runtime.h"
+#include "sharded_env.h"
+#include "phase_profiler.h"
+#include "trace.h"
+#include "latency_stats.h"
+#include "metrics.h"
+#include "logger.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <memory>
 #include <random>
 #include <chrono>
 #include <algorithm>
+#include <numeric>
 #include <thread>
+#include <csignal>
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) {
+    stop_requested = 1;
+}
 
 // Simple RL Agent interfaces
 class RLAgent {
@@ -33,6 +55,8 @@ public:
     RandomAgent() : rng(std::chrono::steady_clock::now().time_since_epoch().count()),
                    action_type_dist(0, 6), position_dist(0, 19) {}
     
+    explicit RandomAgent(unsigned int seed) : rng(seed), action_type_dist(0, 6), position_dist(0, 19) {}
+    
     std::vector<int> get_action(const std::vector<float>& observation) override {
         return {action_type_dist(rng), position_dist(rng), position_dist(rng)};
     }
@@ -49,30 +73,331 @@ public:
     void load_model(const std::string& filepath) override {}
 };
 
+// Linear policy: one score per action part (7 action types, 20 columns, 20 rows)
+// from the observation, acting greedily on each part. Weights are plain floats,
+// so a trainer elsewhere can write them and actors only load them.
+class LinearPolicy : public RLAgent {
+private:
+    static const int NUM_OUTPUTS = 7 + 20 + 20;
+    
+    int observation_size;
+    std::vector<float> weights;  // NUM_OUTPUTS rows of observation_size weights and a bias
+    
+    // One output's score: the dot product runs in LANES independent partial
+    // sums, which the compiler turns into vector code
+    float score(const float* row, const float* observation) const {
+        const int LANES = 8;
+        float partial[LANES] = {};
+        int i = 0;
+        for (; i + LANES <= observation_size; i += LANES) {
+            for (int lane = 0; lane < LANES; lane++) {
+                partial[lane] += row[i + lane] * observation[i + lane];
+            }
+        }
+        float total = row[observation_size];
+        for (int lane = 0; lane < LANES; lane++) {
+            total += partial[lane];
+        }
+        for (; i < observation_size; i++) {
+            total += row[i] * observation[i];
+        }
+        return total;
+    }
+    
+    const float* row(int out) const {
+        return &weights[static_cast<size_t>(out) * (observation_size + 1)];
+    }
+    
+    // Greedy choice per action part: action type, then x, then y
+    static void pick_action(const float* scores, int32_t* action) {
+        const int part_begin[4] = {0, 7, 27, NUM_OUTPUTS};
+        for (int part = 0; part < 3; part++) {
+            const float* part_scores = scores + part_begin[part];
+            int size = part_begin[part + 1] - part_begin[part];
+            action[part] = static_cast<int32_t>(std::max_element(part_scores, part_scores + size) - part_scores);
+        }
+    }
+    
+public:
+    LinearPolicy(int observation_size, unsigned int seed)
+        : observation_size(observation_size),
+          weights(static_cast<size_t>(NUM_OUTPUTS) * (observation_size + 1)) {
+        std::mt19937 rng(seed);
+        std::normal_distribution<float> init(0.0f, 0.01f);
+        for (float& w : weights) {
+            w = init(rng);
+        }
+    }
+    
+    void act(const float* observation, int32_t* action) const {
+        float scores[NUM_OUTPUTS];
+        for (int out = 0; out < NUM_OUTPUTS; out++) {
+            scores[out] = score(row(out), observation);
+        }
+        pick_action(scores, action);
+    }
+    
+    // The same for `count` observations at once. Rows are the outer loop, so each
+    // weight row is fetched once per chunk and reused from L1 for every
+    // observation in it; results match act() exactly.
+    void act_batch(const float* observations, int count, int32_t* actions) const {
+        const int CHUNK = 16;
+        float scores[CHUNK][NUM_OUTPUTS];
+        for (int first = 0; first < count; first += CHUNK) {
+            int size = std::min(CHUNK, count - first);
+            const float* chunk = observations + static_cast<size_t>(first) * observation_size;
+            for (int out = 0; out < NUM_OUTPUTS; out++) {
+                const float* weights_row = row(out);
+                for (int b = 0; b < size; b++) {
+                    scores[b][out] = score(weights_row, chunk + static_cast<size_t>(b) * observation_size);
+                }
+            }
+            for (int b = 0; b < size; b++) {
+                pick_action(scores[b], actions + (first + b) * 3);
+            }
+        }
+    }
+    
+    std::vector<int> get_action(const std::vector<float>& observation) override {
+        int32_t action[3];
+        act(observation.data(), action);
+        return {action[0], action[1], action[2]};
+    }
+    
+    void update(const std::vector<float>&, const std::vector<int>&, float,
+                const std::vector<float>&, bool) override {
+        // Trained elsewhere; see save_model / load_model
+    }
+    
+    void save_model(const std::string& filepath) override {
+        std::ofstream out(filepath, std::ios::binary);
+        int32_t size = observation_size;
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(float));
+        if (!out) {
+            std::cerr << "Failed to write policy: " << filepath << std::endl;
+        }
+    }
+    
+    void load_model(const std::string& filepath) override {
+        load_weights(filepath);
+    }
+    
+    bool load_weights(const std::string& filepath) {
+        std::ifstream in(filepath, std::ios::binary);
+        int32_t size = 0;
+        in.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (!in || size != observation_size) {
+            std::cerr << "Not a policy for " << observation_size << " observation values: "
+                      << filepath << std::endl;
+            return false;
+        }
+        in.read(reinterpret_cast<char*>(weights.data()), weights.size() * sizeof(float));
+        if (!in) {
+            std::cerr << "Truncated policy file: " << filepath << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// One actor of a fork-server pool: steps its part of the batch with the policy
+static WorkerReport run_actor(int index, int workers, int num_envs, int steps, const Config& config,
+                              std::shared_ptr<const MapBank> map_bank,
+                              std::shared_ptr<const ResetCache> cache, const LinearPolicy& policy) {
+    VectorEnv envs(num_envs, config, 0, index * num_envs, workers * num_envs, cache);
+    envs.set_map_bank(map_bank);
+    envs.reset();
+    
+    WorkerReport report = {};
+    report.ready_ns = steady_now_ns();
+    for (int step = 0; step < steps; step++) {
+        for (int e = 0; e < num_envs; e++) {
+            policy.act(envs.observations() + static_cast<size_t>(e) * envs.observation_size(),
+                       envs.actions() + e * VectorEnv::ACTION_SIZE);
+        }
+        envs.step();
+        for (int e = 0; e < num_envs; e++) {
+            report.total_reward += envs.rewards()[e];
+            report.episodes += envs.dones()[e];
+        }
+    }
+    report.env_steps = static_cast<int64_t>(steps) * num_envs;
+    report.run_seconds = (steady_now_ns() - report.ready_ns) * 1e-9;
+    return report;
+}
+
+// How a termination reason is spelled in JSONL episode records
+static const char* termination_name(TerminationReason reason) {
+    switch (reason) {
+        case TerminationReason::STUCK_CARS: return "stuck_cars";
+        case TerminationReason::OUT_OF_RESOURCES: return "out_of_resources";
+        case TerminationReason::MAX_STEPS: return "max_steps";
+        case TerminationReason::GRIDLOCK: return "gridlock";
+        default: return "none";
+    }
+}
+
+// One episode as a coroutine: wait for the policy's action, step, report the
+// transition. Runs until the game ends or max_steps steps have been taken.
+static EpisodeTask play_episode(EpisodeRuntime& runtime, const Config& config, int episode, unsigned seed,
+                                int max_steps) {
+    MiniMotorwaysEnvironment env;
+    env.set_config(config);
+    env.reset(seed);
+    std::vector<float> observation(env.get_observation_size());
+    std::vector<float> next_observation(observation.size());
+    env.write_observation(observation.data());
+    
+    for (int step = 0; step < max_steps; step++) {
+        std::array<int32_t, 3> action = co_await runtime.next_action(observation.data());
+        env.advance(action[0], action[1], action[2]);
+        env.write_observation(next_observation.data());
+        bool done = env.is_done();
+        co_yield Transition{episode, observation.data(), action, env.get_last_reward(),
+                            next_observation.data(), done};
+        if (done) break;
+        // The sink has read the yielded buffers by the time this episode resumes
+        observation.swap(next_observation);
+    }
+}
+
 int main(int argc, char* argv[]) {
     std::cout << "Mini Motorways RL - OpenGL Version" << std::endl;
     std::cout << "==================================" << std::endl;
     
-    if (argc < 2) {
+    // Options may appear anywhere; everything else is positional
+    Config config;
+    std::shared_ptr<MapBank> map_bank;
+    std::string map_bank_path;
+    std::string policy_path;
+    int report_fd = -1;
+    bool perf_profile = false;
+    bool measure_latency = false;
+    std::string perf_json_path;
+    std::string trace_path;
+    std::string metrics_path;
+    int metrics_port = 0;
+    std::string log_path;
+    std::vector<std::string> args;
+    std::vector<std::string> options;  // Passed on to cold-started workers
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--scenario" && i + 1 < argc) {
+            options.insert(options.end(), {arg, argv[i + 1]});
+            if (!load_config(argv[++i], config)) {
+                return 1;
+            }
+        } else if (arg == "--maps" && i + 1 < argc) {
+            options.insert(options.end(), {arg, argv[i + 1]});
+            map_bank_path = argv[++i];
+        } else if (arg == "--policy" && i + 1 < argc) {
+            options.insert(options.end(), {arg, argv[i + 1]});
+            policy_path = argv[++i];
+        } else if (arg == "--report-fd" && i + 1 < argc) {
+            report_fd = std::stoi(argv[++i]);
+        } else if (arg == "--perf") {
+            perf_profile = true;
+        } else if (arg == "--perf-json" && i + 1 < argc) {
+            perf_profile = true;
+            perf_json_path = argv[++i];
+        } else if (arg == "--latency") {
+            measure_latency = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metrics_port = std::stoi(argv[++i]);
+        } else if (arg == "--log-jsonl" && i + 1 < argc) {
+            log_path = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+    
+    // Opened once every option is read, since the bank must match the scenario
+    if (!map_bank_path.empty()) {
+        map_bank = std::make_shared<MapBank>();
+        if (!map_bank->open(map_bank_path, config)) {
+            return 1;
+        }
+    }
+    
+    if (args.empty()) {
         std::cout << "Usage:" << std::endl;
-        std::cout << "  " << argv[0] << " demo" << std::endl;
+        std::cout << "  " << argv[0] << " demo [heatmap]" << std::endl;
         std::cout << "  " << argv[0] << " train [episodes]" << std::endl;
+        std::cout << "  " << argv[0] << " bench [steps] [grid|nasch] [traffic_stats.csv]" << std::endl;
+        std::cout << "  " << argv[0] << " eval [episodes] [threads] [max_steps]" << std::endl;
+        std::cout << "  " << argv[0] << " genmaps <file> [count] [first_seed]" << std::endl;
+        std::cout << "  " << argv[0] << " serve-shm [name] [num_envs]" << std::endl;
+        std::cout << "  " << argv[0] << " shm-bench [name] [steps]" << std::endl;
+        std::cout << "  " << argv[0] << " worker [address] [num_envs] [seed]" << std::endl;
+        std::cout << "  " << argv[0] << " coordinator <address>[,<address>...] [steps] [pipeline] [stop]" << std::endl;
+        std::cout << "  " << argv[0] << " fork-server [workers] [num_envs] [steps] [cold]" << std::endl;
+        std::cout << "  " << argv[0] << " infer-bench [threads] [steps] [max_batch] [latency_us]" << std::endl;
+        std::cout << "  " << argv[0] << " sched-bench [num_envs] [steps] [envs_per_task] [threads]" << std::endl;
+        std::cout << "  " << argv[0] << " coro-bench [episodes] [threads] [max_batch] [max_steps]" << std::endl;
+        std::cout << "  " << argv[0] << " numa-bench [num_envs] [steps] [shards]" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  --scenario <file>   Game rules (see scenarios/)" << std::endl;
+        std::cout << "  --maps <file>       Start episodes from a map bank made by genmaps" << std::endl;
+        std::cout << "  --policy <file>     Linear policy weights for fork-server actors" << std::endl;
+        std::cout << "  --perf              bench: hardware counters per step phase (Linux)" << std::endl;
+        std::cout << "  --perf-json <file>  The same, also written to a JSON file" << std::endl;
+        std::cout << "  --latency           bench: step, reset, find_path and observation percentiles" << std::endl;
+        std::cout << "  --trace <file>      Chrome trace of the run (builds with MM_ENABLE_TRACING)" << std::endl;
+        std::cout << "  --metrics <file>    Prometheus metrics, rewritten every second" << std::endl;
+        std::cout << "  --metrics-port <n>  The same, served on http://127.0.0.1:<n>/metrics" << std::endl;
+        std::cout << "  --log-jsonl <file>  train: one JSON record per finished episode" << std::endl;
         return 1;
     }
     
-    std::string mode = argv[1];
+    std::string mode = args[0];
+    
+    if (!trace_path.empty()) {
+        if (!trace_start()) {
+            return 1;
+        }
+        trace_set_thread_name("main");
+    }
+    
+    // Live metrics; envs and queues only feed them while an exporter runs
+    MetricsRegistry metrics;
+    EnvMetrics env_metrics(metrics);
+    MetricGauge& task_queue_depth = metrics.gauge("mm_scheduler_queued_tasks", "Tasks waiting in the scheduler");
+    MetricGauge& inference_queue_depth = metrics.gauge("mm_inference_queued_requests",
+                                                       "Requests waiting for an inference batch");
+    MetricsExporter exporter(metrics);
+    EnvMetrics* live_metrics = nullptr;
+    if (!metrics_path.empty() || metrics_port > 0) {
+        // The exporter is a thread, and ProcessPool may only fork a single-threaded parent.
+        // Actors do not feed the metrics anyway.
+        if (mode == "fork-server" || mode == "actor") {
+            std::cerr << "--metrics and --metrics-port are not supported in " << mode << " mode" << std::endl;
+            return 1;
+        }
+        if (!exporter.start(metrics_path, metrics_port)) {
+            return 1;
+        }
+        live_metrics = &env_metrics;
+    }
     
     if (mode == "demo") {
         std::cout << "Running interactive demo..." << std::endl;
         
         MiniMotorwaysEnvironment env;
+        env.set_config(config);
+        env.set_map_bank(map_bank);
         if (!env.initialize()) {
             std::cerr << "Failed to initialize environment" << std::endl;
             return 1;
         }
+        env.set_heatmap_overlay(args.size() > 1 && args[1] == "heatmap");
         
         RandomAgent agent;
-        std::vector<float> observation = env.reset();
+        std::vector<float> observation = map_bank ? env.reset_to_map(0) : env.reset();
         
         std::cout << "Demo running... Close window to exit." << std::endl;
         
@@ -87,27 +412,38 @@ int main(int argc, char* argv[]) {
         std::cout << "Demo finished. Final score: " << env.get_score() << std::endl;
         
     } else if (mode == "train") {
-        int episodes = (argc > 2) ? std::stoi(argv[2]) : 100;
+        int episodes = (args.size() > 1) ? std::stoi(args[1]) : 100;
         
         std::cout << "Training random agent for " << episodes << " episodes..." << std::endl;
         
         MiniMotorwaysEnvironment env;
+        env.set_config(config);
+        env.set_map_bank(map_bank);
         if (!env.initialize()) {
             std::cerr << "Failed to initialize environment" << std::endl;
             return 1;
         }
         
+        env.set_metrics(live_metrics);
+        
         RandomAgent agent;
         std::vector<int> scores;
         
+        // Progress lines and episode records are written by the logger's thread
+        if (!log_start(log_path)) {
+            return 1;
+        }
+        
         for (int episode = 0; episode < episodes; episode++) {
-            std::vector<float> observation = env.reset();
+            auto episode_start = std::chrono::steady_clock::now();
+            bool from_bank = map_bank && map_bank->size() > 0;
+            std::vector<float> observation = from_bank ? env.reset_to_map(episode % map_bank->size()) : env.reset();
             float total_reward = 0.0f;
             
             while (!env.is_done()) {
                 std::vector<int> action = agent.get_action(observation);
                 observation = env.step(action);
-                total_reward += 1.0f; // Simple reward
+                total_reward += env.get_last_reward();
                 
                 // Render every 10th episode
                 if (episode % 10 == 0) {
@@ -117,11 +453,15 @@ int main(int argc, char* argv[]) {
             }
             
             scores.push_back(env.get_score());
+            log_episode(EpisodeRecord{episode, env.get_score(), env.get_step(), total_reward,
+                                      termination_name(env.get_termination_reason()),
+                                      std::chrono::duration<double>(std::chrono::steady_clock::now() - episode_start).count()});
             
             if (episode % 10 == 0) {
-                std::cout << "Episode " << episode << " - Score: " << env.get_score() << std::endl;
+                MM_LOG_INFO("Episode " << episode << " - Score: " << env.get_score());
             }
         }
+        log_stop();
         
         // Calculate average score
         float avg_score = 0;
@@ -133,10 +473,821 @@ int main(int argc, char* argv[]) {
         std::cout << "Training completed!" << std::endl;
         std::cout << "Average score: " << avg_score << std::endl;
         
+    } else if (mode == "bench") {
+        int steps = (args.size() > 1) ? std::stoi(args[1]) : 100000;
+        if (args.size() > 2) {
+            config.traffic_model = (args[2] == "nasch") ? TrafficModel::NAGEL_SCHRECKENBERG
+                                                        : TrafficModel::GRID_STEP;
+        }
+        std::string model = (config.traffic_model == TrafficModel::NAGEL_SCHRECKENBERG) ? "nasch" : "grid";
+        
+        std::cout << "Benchmarking " << steps << " headless steps (" << model << " traffic)..." << std::endl;
+        
+        // No initialize(): stepping never touches the window
+        MiniMotorwaysEnvironment env;
+        env.set_config(config);
+        env.set_map_bank(map_bank);
+        
+        // Episodes use seeds 0, 1, 2, ... (or maps 0, 1, 2, ...); initial maps are generated ahead
+        if (!map_bank) {
+            env.set_reset_cache(std::make_shared<ResetCache>(config, env.get_grid().width(),
+                                                             env.get_grid().height(), 0, 1024));
+        }
+        auto start_episode = [&](int episode) {
+            return map_bank && map_bank->size() > 0 ? env.reset_to_map(episode % map_bank->size()) : env.reset(episode);
+        };
+        
+        PhaseProfiler profiler;
+        if (perf_profile) {
+            if (!profiler.open()) {
+                return 1;
+            }
+            env.set_profiler(&profiler);
+        }
+        LatencyStats latency;
+        if (measure_latency) {
+            env.set_latency_stats(&latency);
+        }
+        
+        RandomAgent agent(0);
+        std::vector<float> observation = start_episode(0);
+        long long car_updates = 0;
+        int episodes = 0;
+        std::chrono::duration<double> reset_time(0);
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < steps; i++) {
+            car_updates += env.get_car_count();
+            observation = env.step(agent.get_action(observation));
+            if (perf_profile) {
+                profiler.end_step();
+            }
+            
+            if (env.is_done()) {
+                auto reset_start = std::chrono::steady_clock::now();
+                observation = start_episode(++episodes);
+                reset_time += std::chrono::steady_clock::now() - reset_start;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        std::cout << "Episodes: " << episodes << std::endl;
+        std::cout << "Steps/sec: " << steps / elapsed.count() << std::endl;
+        std::cout << "Cars updated/sec: " << car_updates / elapsed.count() << std::endl;
+        if (episodes > 0) {
+            std::cout << "Reset time (us): " << reset_time.count() * 1e6 / episodes << std::endl;
+        }
+        if (perf_profile) {
+            profiler.print(std::cout);
+            if (!perf_json_path.empty() && profiler.write_json(perf_json_path)) {
+                std::cout << "Profile written to " << perf_json_path << std::endl;
+            }
+        }
+        if (measure_latency) {
+            latency.print(std::cout);
+        }
+        
+        // Per-tile counters of the episode in progress
+        if (args.size() > 3 && env.write_traffic_stats(args[3])) {
+            std::cout << "Traffic stats written to " << args[3] << std::endl;
+        }
+        
+    } else if (mode == "eval") {
+        int episodes = (args.size() > 1) ? std::stoi(args[1]) : 100;
+        int threads = (args.size() > 2) ? std::max(1, std::stoi(args[2])) : 1;
+        int max_steps = (args.size() > 3) ? std::stoi(args[3]) : 1000;
+        
+        int observation_size = MiniMotorwaysEnvironment().get_observation_size();
+        LinearPolicy policy(observation_size, 0);
+        if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+            return 1;
+        }
+        
+        std::cout << "Evaluating " << episodes << " episodes on " << threads << " threads..." << std::endl;
+        
+        // Every thread records into its own stats; they are merged at the end
+        std::vector<std::unique_ptr<LatencyStats>> thread_latency(threads);
+        std::vector<int64_t> thread_scores(threads, 0);
+        std::vector<int64_t> thread_steps(threads, 0);
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                thread_latency[t] = std::make_unique<LatencyStats>();
+                workers.emplace_back([&, t]() {
+                    MiniMotorwaysEnvironment env;
+                    env.set_config(config);
+                    env.set_map_bank(map_bank);
+                    env.set_latency_stats(thread_latency[t].get());
+                    env.set_metrics(live_metrics);
+                    std::vector<float> observation(observation_size);
+                    for (int episode = t; episode < episodes; episode += threads) {
+                        bool from_bank = map_bank && map_bank->size() > 0;
+                        observation = from_bank ? env.reset_to_map(episode % map_bank->size()) : env.reset(episode);
+                        for (int step = 0; step < max_steps && !env.is_done(); step++) {
+                            int32_t action[3];
+                            policy.act(observation.data(), action);
+                            env.advance(action[0], action[1], action[2]);
+                            env.write_observation(observation.data());
+                        }
+                        thread_scores[t] += env.get_score();
+                        thread_steps[t] += env.get_step();
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        LatencyStats latency;
+        for (const auto& stats : thread_latency) {
+            latency.merge(*stats);
+        }
+        int64_t total_steps = std::accumulate(thread_steps.begin(), thread_steps.end(), int64_t(0));
+        std::cout << "Average score: " << std::accumulate(thread_scores.begin(), thread_scores.end(), int64_t(0)) /
+                                              static_cast<double>(std::max(episodes, 1)) << std::endl;
+        std::cout << "Average length: " << total_steps / static_cast<double>(std::max(episodes, 1)) << " steps" << std::endl;
+        std::cout << "Steps/sec: " << total_steps / elapsed.count() << std::endl;
+        latency.print(std::cout);
+        
+    } else if (mode == "genmaps") {
+        if (args.size() < 2) {
+            std::cerr << "genmaps needs an output file" << std::endl;
+            return 1;
+        }
+        int count = (args.size() > 2) ? std::stoi(args[2]) : 100000;
+        unsigned first_seed = (args.size() > 3) ? std::stoul(args[3]) : 0;
+        
+        std::cout << "Generating " << count << " maps from seed " << first_seed << "..." << std::endl;
+        
+        MiniMotorwaysEnvironment env;
+        if (!MapBank::write(args[1], config, env.get_grid().width(), env.get_grid().height(),
+                            first_seed, count)) {
+            return 1;
+        }
+        std::cout << "Map bank written to " << args[1] << std::endl;
+        
+    } else if (mode == "serve-shm") {
+        std::string name = (args.size() > 1) ? args[1] : "/mini_motorways";
+        int num_envs = (args.size() > 2) ? std::stoi(args[2]) : 16;
+        
+        MiniMotorwaysEnvironment probe;
+        probe.set_config(config);
+        
+        ShmChannel channel;
+        if (!channel.create(name, num_envs, probe.get_observation_size(), VectorEnv::ACTION_SIZE)) {
+            return 1;
+        }
+        
+        // Observations, rewards and done flags are written straight into the region
+        VectorEnv::Buffers buffers;
+        buffers.actions = channel.actions();
+        buffers.observations = channel.observations();
+        buffers.rewards = channel.rewards();
+        buffers.dones = channel.dones();
+        VectorEnv envs(num_envs, config, 0, buffers);
+        envs.set_map_bank(map_bank);
+        
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+        std::cout << "Serving " << num_envs << " environments on " << name << " (Ctrl+C to stop)" << std::endl;
+        
+        long long requests = 0;
+        while (!stop_requested) {
+            ShmCommand command = channel.wait_request(100);
+            if (command == ShmCommand::NONE) continue;
+            
+            if (command == ShmCommand::RESET) {
+                envs.reset();
+            } else if (command == ShmCommand::STEP) {
+                envs.step();
+            }
+            channel.respond();
+            requests++;
+            
+            if (command == ShmCommand::SHUTDOWN) break;
+        }
+        
+        std::cout << "Served " << requests << " requests, " << envs.get_finished_episodes()
+                  << " episodes finished" << std::endl;
+        
+    } else if (mode == "shm-bench") {
+        std::string name = (args.size() > 1) ? args[1] : "/mini_motorways";
+        int steps = (args.size() > 2) ? std::stoi(args[2]) : 10000;
+        
+        ShmChannel channel;
+        if (!channel.attach(name)) {
+            return 1;
+        }
+        int num_envs = channel.num_envs();
+        std::cout << "Attached to " << name << ": " << num_envs << " environments, "
+                  << channel.observation_size() << " floats per observation" << std::endl;
+        
+        // Round trip with no environment work
+        const int pings = 10000;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < pings; i++) {
+            if (!channel.call(ShmCommand::PING)) {
+                return 1;
+            }
+        }
+        std::chrono::duration<double> ping_time = std::chrono::steady_clock::now() - start;
+        
+        if (!channel.call(ShmCommand::RESET)) {
+            return 1;
+        }
+        
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<int> action_type_dist(0, 6);
+        std::uniform_int_distribution<int> position_dist(0, 19);
+        double total_reward = 0.0;
+        long long episodes = 0;
+        
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < steps; i++) {
+            int32_t* actions = channel.actions();
+            for (int e = 0; e < num_envs; e++) {
+                actions[e * VectorEnv::ACTION_SIZE] = action_type_dist(rng);
+                actions[e * VectorEnv::ACTION_SIZE + 1] = position_dist(rng);
+                actions[e * VectorEnv::ACTION_SIZE + 2] = position_dist(rng);
+            }
+            if (!channel.call(ShmCommand::STEP)) {
+                return 1;
+            }
+            for (int e = 0; e < num_envs; e++) {
+                total_reward += channel.rewards()[e];
+                episodes += channel.dones()[e];
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        std::cout << "Round trip (us): " << ping_time.count() * 1e6 / pings << std::endl;
+        std::cout << "Batches/sec: " << steps / elapsed.count() << std::endl;
+        std::cout << "Env steps/sec: " << static_cast<double>(steps) * num_envs / elapsed.count() << std::endl;
+        std::cout << "Episodes: " << episodes << ", total reward: " << total_reward << std::endl;
+        
+    } else if (mode == "worker") {
+        std::string address = (args.size() > 1) ? args[1] : "unix:/tmp/mini_motorways.sock";
+        int num_envs = (args.size() > 2) ? std::stoi(args[2]) : 16;
+        unsigned seed = (args.size() > 3) ? std::stoul(args[3]) : 0;
+        
+        VectorEnv envs(num_envs, config, seed);
+        envs.set_map_bank(map_bank);
+        
+        std::cout << "Rollout worker with " << num_envs << " environments on " << address << std::endl;
+        if (!run_rollout_worker(address, envs)) {
+            return 1;
+        }
+        std::cout << "Worker stopped, " << envs.get_finished_episodes() << " episodes finished" << std::endl;
+        
+    } else if (mode == "coordinator") {
+        if (args.size() < 2) {
+            std::cerr << "coordinator needs worker addresses" << std::endl;
+            return 1;
+        }
+        std::vector<std::string> addresses;
+        std::stringstream address_list(args[1]);
+        for (std::string address; std::getline(address_list, address, ',');) {
+            addresses.push_back(address);
+        }
+        int steps = (args.size() > 2) ? std::stoi(args[2]) : 1000;
+        int pipeline = (args.size() > 3) ? std::stoi(args[3]) : 2;
+        bool stop_workers = args.size() > 4 && args[4] == "stop";
+        
+        RolloutCoordinator coordinator;
+        if (!coordinator.connect(addresses, pipeline)) {
+            return 1;
+        }
+        const std::vector<RolloutCoordinator::Slice>& slices = coordinator.get_slices();
+        std::cout << "Driving " << coordinator.num_envs() << " environments on " << addresses.size()
+                  << " workers in " << slices.size() << " slices..." << std::endl;
+        
+        // Every slice runs `steps` steps; a slice's next step goes out as soon as its results are in
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<int> action_type_dist(0, 6);
+        std::uniform_int_distribution<int> position_dist(0, 19);
+        std::vector<int32_t> actions;
+        std::vector<int> slice_steps(slices.size(), 0);
+        long long env_steps = 0;
+        long long episodes = 0;
+        double total_reward = 0.0;
+        
+        auto start = std::chrono::steady_clock::now();
+        int in_flight = 0;
+        for (size_t s = 0; s < slices.size(); s++) {
+            if (!coordinator.reset(s)) {
+                return 1;
+            }
+            in_flight++;
+        }
+        while (in_flight > 0) {
+            int s = coordinator.receive();
+            if (s < 0) {
+                return 1;
+            }
+            in_flight--;
+            
+            const RolloutCoordinator::Slice& slice = slices[s];
+            for (int e = slice.global_first; e < slice.global_first + slice.count; e++) {
+                total_reward += coordinator.get_reward(e);
+                episodes += coordinator.get_done(e);
+            }
+            if (slice_steps[s] == steps) continue;
+            
+            actions.resize(slice.count * VectorEnv::ACTION_SIZE);
+            for (int e = 0; e < slice.count; e++) {
+                actions[e * VectorEnv::ACTION_SIZE] = action_type_dist(rng);
+                actions[e * VectorEnv::ACTION_SIZE + 1] = position_dist(rng);
+                actions[e * VectorEnv::ACTION_SIZE + 2] = position_dist(rng);
+            }
+            if (!coordinator.step(s, actions.data())) {
+                return 1;
+            }
+            slice_steps[s]++;
+            env_steps += slice.count;
+            in_flight++;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        if (stop_workers) {
+            coordinator.shutdown();
+        }
+        
+        std::cout << "Env steps/sec: " << env_steps / elapsed.count() << std::endl;
+        std::cout << "Observation bytes per env: "
+                  << compact_observation_size(coordinator.observation_size(), coordinator.tile_count())
+                  << " (raw " << coordinator.observation_size() * sizeof(float) << ")" << std::endl;
+        std::cout << "Episodes: " << episodes << ", total reward: " << total_reward << std::endl;
+        
+    } else if (mode == "fork-server" || mode == "actor") {
+        // fork-server starts the workers; actor is one cold-started worker
+        bool actor = mode == "actor";
+        size_t first_arg = actor ? 2 : 1;
+        int workers = (args.size() > first_arg) ? std::stoi(args[first_arg]) : 4;
+        int num_envs = (args.size() > first_arg + 1) ? std::stoi(args[first_arg + 1]) : 16;
+        int steps = (args.size() > first_arg + 2) ? std::stoi(args[first_arg + 2]) : 1000;
+        
+        if (actor) {
+            int index = std::stoi(args.at(1));
+            LinearPolicy policy(MiniMotorwaysEnvironment().get_observation_size(), 0);
+            if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+                return 1;
+            }
+            WorkerReport report = run_actor(index, workers, num_envs, steps, config, map_bank,
+                                            nullptr, policy);
+            return send_worker_report(report_fd, report) ? 0 : 1;
+        }
+        
+        bool cold = args.size() > 4 && args[4] == "cold";
+        std::cout << "Starting " << workers << " " << (cold ? "cold" : "forked") << " workers with "
+                  << num_envs << " environments each..." << std::endl;
+        
+        int64_t setup_start = steady_now_ns();
+        ProcessPool pool;
+        if (cold) {
+            // argv[0] has no directory when the program was found through PATH
+            std::string program = current_executable(argv[0]);
+            for (int w = 0; w < workers; w++) {
+                std::vector<std::string> worker_argv = {program, "actor", std::to_string(w),
+                                                        std::to_string(workers), std::to_string(num_envs),
+                                                        std::to_string(steps)};
+                worker_argv.insert(worker_argv.end(), options.begin(), options.end());
+                if (!pool.spawn_worker(worker_argv)) {
+                    return 1;
+                }
+            }
+        } else {
+            // Policy and start states are built once and shared copy-on-write;
+            // the scenario and map bank were loaded above
+            LinearPolicy policy(MiniMotorwaysEnvironment().get_observation_size(), 0);
+            if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+                return 1;
+            }
+            std::shared_ptr<ResetCache> cache = VectorEnv::make_reset_cache(config, 0, workers * num_envs);
+            cache->wait();
+            std::cout << "Parent setup (ms): " << (steady_now_ns() - setup_start) * 1e-6 << std::endl;
+            
+            for (int w = 0; w < workers; w++) {
+                bool forked = pool.fork_worker([&](int index) {
+                    return run_actor(index, workers, num_envs, steps, config, map_bank, cache, policy);
+                });
+                if (!forked) {
+                    return 1;
+                }
+            }
+        }
+        
+        std::vector<WorkerReport> reports;
+        std::vector<double> startup_seconds;
+        if (!pool.wait(reports, startup_seconds)) {
+            return 1;
+        }
+        double elapsed = (steady_now_ns() - setup_start) * 1e-9;
+        
+        double mean_startup = 0.0;
+        double max_startup = 0.0;
+        long long env_steps = 0;
+        long long episodes = 0;
+        double total_reward = 0.0;
+        for (size_t w = 0; w < reports.size(); w++) {
+            mean_startup += startup_seconds[w] / reports.size();
+            max_startup = std::max(max_startup, startup_seconds[w]);
+            env_steps += reports[w].env_steps;
+            episodes += reports[w].episodes;
+            total_reward += reports[w].total_reward;
+        }
+        std::cout << "Worker startup (ms): mean " << mean_startup * 1e3 << ", max " << max_startup * 1e3 << std::endl;
+        std::cout << "Env steps/sec (including startup): " << env_steps / elapsed << std::endl;
+        std::cout << "Episodes: " << episodes << ", total reward: " << total_reward << std::endl;
+        
+    } else if (mode == "infer-bench") {
+        int threads = (args.size() > 1) ? std::stoi(args[1]) : 8;
+        int steps = (args.size() > 2) ? std::stoi(args[2]) : 2000;
+        int max_batch = (args.size() > 3) ? std::stoi(args[3]) : 32;
+        int latency_us = (args.size() > 4) ? std::stoi(args[4]) : 200;
+        
+        int observation_size = MiniMotorwaysEnvironment().get_observation_size();
+        LinearPolicy policy(observation_size, 0);
+        if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+            return 1;
+        }
+        
+        // Every thread plays its own episodes (seeds t, t + threads, ...) and asks for one action per step
+        auto run_actors = [&](InferenceServer* server, double& total_reward) {
+            std::vector<std::thread> actors;
+            std::vector<double> rewards(threads, 0.0);
+            auto start = std::chrono::steady_clock::now();
+            for (int t = 0; t < threads; t++) {
+                actors.emplace_back([&, t]() {
+                    MiniMotorwaysEnvironment env;
+                    env.set_config(config);
+                    env.set_metrics(live_metrics);
+                    unsigned seed = t;
+                    env.reset(seed);
+                    std::vector<float> observation(observation_size);
+                    env.write_observation(observation.data());
+                    
+                    int32_t action[3];
+                    for (int step = 0; step < steps; step++) {
+                        if (server) {
+                            server->infer(observation.data(), action);
+                        } else {
+                            policy.act(observation.data(), action);
+                        }
+                        env.advance(action[0], action[1], action[2]);
+                        rewards[t] += env.get_last_reward();
+                        if (env.is_done()) {
+                            seed += threads;
+                            env.reset(seed);
+                        }
+                        env.write_observation(observation.data());
+                    }
+                });
+            }
+            for (auto& actor : actors) {
+                actor.join();
+            }
+            total_reward = std::accumulate(rewards.begin(), rewards.end(), 0.0);
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+        
+        // The kernels alone, on one observation at a time and on full batches
+        {
+            const int reps = 256;
+            std::vector<float> observations(static_cast<size_t>(max_batch) * observation_size, 0.5f);
+            std::vector<int32_t> actions(max_batch * 3);
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; r++) {
+                for (int i = 0; i < max_batch; i++) {
+                    policy.act(&observations[static_cast<size_t>(i) * observation_size], &actions[i * 3]);
+                }
+            }
+            std::chrono::duration<double> single = std::chrono::steady_clock::now() - start;
+            start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; r++) {
+                policy.act_batch(observations.data(), max_batch, actions.data());
+            }
+            std::chrono::duration<double> batched = std::chrono::steady_clock::now() - start;
+            std::cout << "Policy kernel (us per observation): " << single.count() * 1e6 / (reps * max_batch)
+                      << " single, " << batched.count() * 1e6 / (reps * max_batch) << " in batches of "
+                      << max_batch << std::endl;
+        }
+        
+        std::cout << "Benchmarking " << threads << " actor threads, " << steps << " steps each..." << std::endl;
+        double direct_reward = 0.0;
+        double direct_time = run_actors(nullptr, direct_reward);
+        std::cout << "Per-thread policy: " << threads * steps / direct_time << " steps/sec" << std::endl;
+        
+        InferenceServer server(observation_size, 3, max_batch, latency_us,
+                               [&policy](const float* observations, int count, int32_t* actions) {
+                                   policy.act_batch(observations, count, actions);
+                               });
+        server.set_queue_gauge(live_metrics ? &inference_queue_depth : nullptr);
+        double batched_reward = 0.0;
+        double batched_time = run_actors(&server, batched_reward);
+        server.stop();
+        std::cout << "Batched server (max " << max_batch << ", " << latency_us << " us): "
+                  << threads * steps / batched_time << " steps/sec" << std::endl;
+        
+        // The same batching, with batches run as tasks of a shared scheduler instead of the server's thread
+        double scheduled_reward = 0.0;
+        double scheduled_time = 0.0;
+        {
+            TaskScheduler scheduler;
+            InferenceServer scheduled_server(observation_size, 3, max_batch, latency_us,
+                                             [&policy](const float* observations, int count, int32_t* actions) {
+                                                 policy.act_batch(observations, count, actions);
+                                             },
+                                             scheduler);
+            scheduled_time = run_actors(&scheduled_server, scheduled_reward);
+            scheduled_server.stop();
+            std::cout << "Batched on a task scheduler (" << scheduler.size() << " workers): "
+                      << threads * steps / scheduled_time << " steps/sec" << std::endl;
+        }
+        std::cout << "Total reward: " << direct_reward << " per-thread, " << batched_reward << " batched, "
+                  << scheduled_reward << " scheduled" << std::endl;
+        
+        server.get_batch_sizes().print(std::cout, "Batch size", "requests");
+        server.get_latencies_us().print(std::cout, "Inference latency", "us");
+        
+    } else if (mode == "sched-bench") {
+        int num_envs = (args.size() > 1) ? std::stoi(args[1]) : 64;
+        int steps = (args.size() > 2) ? std::stoi(args[2]) : 500;
+        int envs_per_task = (args.size() > 3) ? std::max(1, std::stoi(args[3])) : 4;
+        int threads = (args.size() > 4) ? std::stoi(args[4]) : 0;
+        if (threads <= 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        
+        int observation_size = MiniMotorwaysEnvironment().get_observation_size();
+        LinearPolicy policy(observation_size, 0);
+        if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+            return 1;
+        }
+        // Both runs start from the same maps, generated before any timing
+        std::shared_ptr<ResetCache> cache = VectorEnv::make_reset_cache(config, 0, num_envs);
+        cache->wait();
+        
+        // Each slice of envs alternates inference and a step until it has taken
+        // `steps` steps. Inference is HIGH priority, so a slice that has just
+        // stepped gets its actions before other slices step again; steps are
+        // queued through VectorEnv::submit_step().
+        auto run_slices = [&](TaskScheduler& env_pool, TaskScheduler& inference_pool, double& total_reward) {
+            VectorEnv envs(num_envs, config, 0, 0, num_envs, cache);
+            envs.set_metrics(live_metrics);
+            envs.reset(env_pool, envs_per_task);
+            int slices = (num_envs + envs_per_task - 1) / envs_per_task;
+            std::vector<int> steps_taken(slices, 0);
+            std::vector<double> rewards(slices, 0.0);
+            TaskScheduler::TaskGroup group;
+            
+            std::function<void(int)> infer;
+            std::function<void(int)> stepped;
+            infer = [&](int slice) {
+                int first = slice * envs_per_task;
+                int count = std::min(envs_per_task, num_envs - first);
+                policy.act_batch(envs.observations() + static_cast<size_t>(first) * observation_size, count,
+                                 envs.actions() + first * VectorEnv::ACTION_SIZE);
+                envs.submit_step(env_pool, first, count, &group, [&stepped, slice]() { stepped(slice); });
+            };
+            stepped = [&](int slice) {
+                int first = slice * envs_per_task;
+                int count = std::min(envs_per_task, num_envs - first);
+                for (int e = first; e < first + count; e++) {
+                    rewards[slice] += envs.rewards()[e];
+                }
+                if (++steps_taken[slice] < steps) {
+                    inference_pool.submit([&infer, slice]() { infer(slice); }, TaskScheduler::HIGH, &group);
+                }
+            };
+            
+            auto start = std::chrono::steady_clock::now();
+            for (int slice = 0; slice < slices; slice++) {
+                inference_pool.submit([&infer, slice]() { infer(slice); }, TaskScheduler::HIGH, &group);
+            }
+            env_pool.wait(group);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            total_reward = std::accumulate(rewards.begin(), rewards.end(), 0.0);
+            return elapsed.count();
+        };
+        
+        std::cout << "Benchmarking " << num_envs << " envs in tasks of " << envs_per_task << ", "
+                  << steps << " steps each, " << threads << " threads per pool..." << std::endl;
+        
+        double unified_reward = 0.0;
+        double unified_time = 0.0;
+        {
+            TaskScheduler scheduler(threads);
+            scheduler.set_queue_gauge(live_metrics ? &task_queue_depth : nullptr);
+            unified_time = run_slices(scheduler, scheduler, unified_reward);
+            std::cout << "Unified scheduler: " << num_envs * static_cast<double>(steps) / unified_time
+                      << " steps/sec (" << scheduler.get_executed_tasks() << " tasks, "
+                      << scheduler.get_stolen_tasks() << " stolen)" << std::endl;
+        }
+        
+        double separate_reward = 0.0;
+        double separate_time = 0.0;
+        {
+            TaskScheduler env_pool(threads);
+            TaskScheduler inference_pool(threads);
+            separate_time = run_slices(env_pool, inference_pool, separate_reward);
+            std::cout << "Separate env and inference pools: " << num_envs * static_cast<double>(steps) / separate_time
+                      << " steps/sec" << std::endl;
+        }
+        std::cout << "Total reward: " << unified_reward << " unified, " << separate_reward << " separate" << std::endl;
+        
+    } else if (mode == "numa-bench") {
+        int num_envs = (args.size() > 1) ? std::stoi(args[1]) : 256;
+        int steps = (args.size() > 2) ? std::stoi(args[2]) : 500;
+        int num_shards = (args.size() > 3) ? std::stoi(args[3]) : 0;
+        
+        int observation_size = MiniMotorwaysEnvironment().get_observation_size();
+        LinearPolicy policy(observation_size, 0);
+        if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+            return 1;
+        }
+        
+        // Act and step one slice of a batch `steps` times; returns the reward collected
+        auto run_slice = [&](VectorEnv& envs, int first, int count) {
+            double reward = 0.0;
+            for (int step = 0; step < steps; step++) {
+                for (int e = first; e < first + count; e++) {
+                    policy.act(envs.observations() + static_cast<size_t>(e) * observation_size,
+                               envs.actions() + e * VectorEnv::ACTION_SIZE);
+                }
+                envs.step(first, count);
+                for (int e = first; e < first + count; e++) {
+                    reward += envs.rewards()[e];
+                }
+            }
+            return reward;
+        };
+        
+        ShardedVectorEnv sharded(num_envs, config, 0, num_shards);
+        sharded.set_map_bank(map_bank);
+        num_shards = sharded.num_shards();
+        for (const NumaNode& node : sharded.get_nodes()) {
+            std::cout << "Node " << node.id << ": " << node.cpus.size() << " CPUs" << std::endl;
+        }
+        std::cout << "Benchmarking " << num_envs << " envs in " << num_shards << " shards, " << steps
+                  << " steps..." << std::endl;
+        
+        // Sharded: every shard acts and steps on its own pinned thread, on memory it allocated
+        std::vector<double> shard_seconds(num_shards);
+        std::vector<double> shard_rewards(num_shards);
+        sharded.reset();
+        auto start = std::chrono::steady_clock::now();
+        sharded.for_each_shard([&](int shard, VectorEnv& envs) {
+            auto shard_start = std::chrono::steady_clock::now();
+            shard_rewards[shard] = run_slice(envs, 0, envs.size());
+            shard_seconds[shard] = std::chrono::duration<double>(std::chrono::steady_clock::now() - shard_start).count();
+        });
+        std::chrono::duration<double> sharded_time = std::chrono::steady_clock::now() - start;
+        
+        std::cout << "Sharded: " << num_envs * static_cast<double>(steps) / sharded_time.count() << " steps/sec" << std::endl;
+        for (const NumaNode& node : sharded.get_nodes()) {
+            int64_t node_steps = 0;
+            double node_seconds = 0.0;
+            for (int shard = 0; shard < num_shards; shard++) {
+                if (sharded.shard_node(shard) != node.id) continue;
+                node_steps += static_cast<int64_t>(sharded.shard(shard).size()) * steps;
+                node_seconds = std::max(node_seconds, shard_seconds[shard]);
+            }
+            if (node_steps > 0) {
+                std::cout << "  Node " << node.id << ": " << node_steps / node_seconds << " steps/sec" << std::endl;
+            }
+        }
+        
+        // Baseline: one batch built on this thread, its slices stepped by unpinned threads
+        VectorEnv envs(num_envs, config, 0);
+        envs.set_map_bank(map_bank);
+        envs.reset();
+        std::vector<double> slice_rewards(num_shards);
+        start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::thread> workers;
+            for (int shard = 0; shard < num_shards; shard++) {
+                workers.emplace_back([&, shard]() {
+                    slice_rewards[shard] = run_slice(envs, sharded.shard_first_env(shard), sharded.shard(shard).size());
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        std::chrono::duration<double> shared_time = std::chrono::steady_clock::now() - start;
+        std::cout << "Unpinned threads on one batch: " << num_envs * static_cast<double>(steps) / shared_time.count()
+                  << " steps/sec" << std::endl;
+        std::cout << "Total reward: " << std::accumulate(shard_rewards.begin(), shard_rewards.end(), 0.0)
+                  << " sharded, " << std::accumulate(slice_rewards.begin(), slice_rewards.end(), 0.0)
+                  << " one batch" << std::endl;
+        
+    } else if (mode == "coro-bench") {
+        int episodes = (args.size() > 1) ? std::stoi(args[1]) : 1024;
+        int threads = (args.size() > 2) ? std::max(1, std::stoi(args[2])) : 2;
+        int max_batch = (args.size() > 3) ? std::stoi(args[3]) : 64;
+        int max_steps = (args.size() > 4) ? std::stoi(args[4]) : 200;
+        
+        int observation_size = MiniMotorwaysEnvironment().get_observation_size();
+        LinearPolicy policy(observation_size, 0);
+        if (!policy_path.empty() && !policy.load_weights(policy_path)) {
+            return 1;
+        }
+        
+        // Baseline: each thread plays its episodes one after another, one action at a time
+        auto strict_start = std::chrono::steady_clock::now();
+        std::vector<double> strict_rewards(threads, 0.0);
+        std::vector<int64_t> strict_steps(threads, 0);
+        {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    MiniMotorwaysEnvironment env;
+                    env.set_config(config);
+                    std::vector<float> observation(observation_size);
+                    for (int episode = t; episode < episodes; episode += threads) {
+                        env.reset(episode);
+                        env.write_observation(observation.data());
+                        for (int step = 0; step < max_steps; step++) {
+                            int32_t action[3];
+                            policy.act(observation.data(), action);
+                            env.advance(action[0], action[1], action[2]);
+                            env.write_observation(observation.data());
+                            strict_rewards[t] += env.get_last_reward();
+                            strict_steps[t]++;
+                            if (env.is_done()) break;
+                        }
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        std::chrono::duration<double> strict_time = std::chrono::steady_clock::now() - strict_start;
+        
+        // Coroutines: every episode of a thread is in flight at once, sharing batched policy calls
+        auto coro_start = std::chrono::steady_clock::now();
+        std::vector<double> coro_rewards(threads, 0.0);
+        std::vector<int64_t> coro_steps(threads, 0);
+        std::vector<int64_t> coro_batches(threads, 0);
+        {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    EpisodeRuntime runtime(observation_size, max_batch,
+                                           [&policy](const float* observations, int count, int32_t* actions) {
+                                               policy.act_batch(observations, count, actions);
+                                           },
+                                           [&, t](const Transition* transitions, int count) {
+                                               for (int i = 0; i < count; i++) {
+                                                   coro_rewards[t] += transitions[i].reward;
+                                               }
+                                               coro_steps[t] += count;
+                                           });
+                    for (int episode = t; episode < episodes; episode += threads) {
+                        runtime.spawn(play_episode(runtime, config, episode, episode, max_steps));
+                    }
+                    runtime.run();
+                    coro_batches[t] = runtime.get_batches();
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        std::chrono::duration<double> coro_time = std::chrono::steady_clock::now() - coro_start;
+        
+        int64_t total_strict_steps = std::accumulate(strict_steps.begin(), strict_steps.end(), int64_t(0));
+        int64_t total_coro_steps = std::accumulate(coro_steps.begin(), coro_steps.end(), int64_t(0));
+        int64_t total_batches = std::accumulate(coro_batches.begin(), coro_batches.end(), int64_t(0));
+        std::cout << episodes << " episodes of up to " << max_steps << " steps on " << threads << " threads" << std::endl;
+        std::cout << "Strict loop: " << total_strict_steps / strict_time.count() << " steps/sec" << std::endl;
+        std::cout << "Coroutines: " << total_coro_steps / coro_time.count() << " steps/sec, " << total_batches
+                  << " policy batches (mean " << (total_batches ? static_cast<double>(total_coro_steps) / total_batches : 0.0)
+                  << ")" << std::endl;
+        std::cout << "Total reward: " << std::accumulate(strict_rewards.begin(), strict_rewards.end(), 0.0)
+                  << " strict, " << std::accumulate(coro_rewards.begin(), coro_rewards.end(), 0.0)
+                  << " coroutines" << std::endl;
+        
     } else {
         std::cerr << "Unknown mode: " << mode << std::endl;
         return 1;
     }
     
+    exporter.stop();
+    if (!metrics_path.empty()) {
+        std::cout << "Metrics written to " << metrics_path << std::endl;
+    }
+    
+    if (!trace_path.empty()) {
+        trace_stop();
+        if (trace_write(trace_path)) {
+            std::cout << "Trace written to " << trace_path << std::endl;
+        }
+    }
+    
     return 0;
 }
\ No newline at end of file
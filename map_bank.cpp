@@ -0,0 +1,137 @@
+#include "mini_motorways_env.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <type_traits>
+
+// Records are stored exactly as laid out in memory
+static_assert(std::is_trivially_copyable<MapLayout>::value, "MapLayout must be trivially copyable");
+static_assert(sizeof(MapLayout) == 8 + 4 * MapLayout::MAX_BUILDINGS, "MapLayout must not be padded");
+static_assert(sizeof(MapBank::Header) == 32, "MapBank::Header must not be padded");
+
+namespace {
+
+// Whether a record can be laid out on a grid_width x grid_height map without
+// reading or writing outside the environment's arrays
+bool valid_layout(const MapLayout& layout, uint32_t grid_width, uint32_t grid_height) {
+    if (layout.building_count > MapLayout::MAX_BUILDINGS) return false;
+    if (layout.active_colors < 1 || layout.active_colors > NUM_CAR_COLORS) return false;
+    for (int i = 0; i < layout.building_count; i++) {
+        const MapLayout::PackedBuilding& building = layout.buildings[i];
+        if (building.x >= grid_width || building.y >= grid_height) return false;
+        if (building.type != static_cast<uint8_t>(TileType::HOUSE) &&
+            building.type != static_cast<uint8_t>(TileType::BUSINESS)) return false;
+        if (building.color >= NUM_CAR_COLORS) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// MapBank Implementation
+MapBank::~MapBank() {
+    close();
+}
+
+bool MapBank::open(const std::string& filepath, const Config& config) {
+    close();
+    
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open map bank: " << filepath << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        std::cerr << "Map bank is too small: " << filepath << std::endl;
+        ::close(fd);
+        return false;
+    }
+    
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // The mapping keeps the file open
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map map bank: " << filepath << std::endl;
+        return false;
+    }
+    
+    const Header* file_header = static_cast<const Header*>(data);
+    size_t expected_size = sizeof(Header) +
+                           static_cast<size_t>(file_header->map_count) * sizeof(MapLayout);
+    if (file_header->magic != MAGIC || file_header->version != VERSION ||
+        file_header->record_size != sizeof(MapLayout) ||
+        static_cast<size_t>(info.st_size) != expected_size) {
+        std::cerr << "Not a version " << VERSION << " map bank: " << filepath << std::endl;
+        munmap(data, info.st_size);
+        return false;
+    }
+    if (file_header->map_count == 0) {
+        std::cerr << "Map bank holds no maps: " << filepath << std::endl;
+        munmap(data, info.st_size);
+        return false;
+    }
+    if (file_header->config_hash != config_hash(config)) {
+        std::cerr << "Map bank " << filepath << " was generated for another scenario "
+                  << "(run genmaps with the same --scenario)" << std::endl;
+        munmap(data, info.st_size);
+        return false;
+    }
+    
+    // Records are not read here, so opening touches one page however large the bank
+    mapping = data;
+    mapping_size = info.st_size;
+    header = file_header;
+    layouts = reinterpret_cast<const MapLayout*>(static_cast<const char*>(data) + sizeof(Header));
+    return true;
+}
+
+bool MapBank::valid_map(int index) const {
+    return index >= 0 && index < size() && valid_layout(layouts[index], header->grid_width, header->grid_height);
+}
+
+void MapBank::close() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    header = nullptr;
+    layouts = nullptr;
+}
+
+bool MapBank::write(const std::string& filepath, const Config& config, int grid_width,
+                    int grid_height, unsigned first_seed, int count) {
+    if (grid_width > 256 || grid_height > 256) {
+        std::cerr << "Map banks hold grids of at most 256x256 tiles" << std::endl;
+        return false;
+    }
+    if (count <= 0) {
+        std::cerr << "A map bank needs at least one map" << std::endl;
+        return false;
+    }
+    
+    std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create map bank: " << filepath << std::endl;
+        return false;
+    }
+    
+    Header file_header = {MAGIC, VERSION, sizeof(MapLayout),
+                          static_cast<uint32_t>(grid_width), static_cast<uint32_t>(grid_height),
+                          static_cast<uint32_t>(count), config_hash(config)};
+    out.write(reinterpret_cast<const char*>(&file_header), sizeof(file_header));
+    
+    MapLayout layout;
+    for (int i = 0; i < count; i++) {
+        ResetCache::generate_layout(first_seed + i, config, grid_width, grid_height, layout);
+        out.write(reinterpret_cast<const char*>(&layout), sizeof(layout));
+    }
+    
+    if (!out) {
+        std::cerr << "Failed to write map bank: " << filepath << std::endl;
+        return false;
+    }
+    return true;
+}
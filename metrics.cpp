@@ -0,0 +1,208 @@
+#include "metrics.h"
+#include "rollout.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;  // A scraper that hung up is not worth a SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// Waits are cut into slices this long so stop() never blocks for a whole interval
+const int POLL_SLICE_MS = 100;
+
+}  // namespace
+
+// MetricsRegistry Implementation
+MetricsRegistry::Metric& MetricsRegistry::add_metric(const std::string& name, const std::string& help, Type type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& metric : metrics) {
+        if (metric->name == name) return *metric;
+    }
+    metrics.push_back(std::make_unique<Metric>());
+    Metric& metric = *metrics.back();
+    metric.name = name;
+    metric.help = help;
+    metric.type = type;
+    return metric;
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    return add_metric(name, help, Type::COUNTER).counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    return add_metric(name, help, Type::GAUGE).gauge;
+}
+
+void MetricsRegistry::computed_gauge(const std::string& name, const std::string& help,
+                                     std::function<double()> compute) {
+    Metric& metric = add_metric(name, help, Type::GAUGE);
+    std::lock_guard<std::mutex> lock(mutex);  // render() may be reading it
+    metric.compute = std::move(compute);
+}
+
+void MetricsRegistry::rate(const std::string& name, const std::string& help, const MetricCounter& counter) {
+    auto last_time = std::chrono::steady_clock::now();
+    uint64_t last_value = counter.get();
+    // Runs under the registry lock, so the captured state needs no guard of its own
+    computed_gauge(name, help, [&counter, last_time, last_value]() mutable {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t value = counter.get();
+        double seconds = std::chrono::duration<double>(now - last_time).count();
+        double per_second = seconds > 0 ? (value - last_value) / seconds : 0.0;
+        last_time = now;
+        last_value = value;
+        return per_second;
+    });
+}
+
+std::string MetricsRegistry::render() const {
+    std::ostringstream out;
+    out.precision(17);  // Round-trips a double
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& metric : metrics) {
+        out << "# HELP " << metric->name << " " << metric->help << "\n";
+        if (metric->type == Type::COUNTER) {
+            out << "# TYPE " << metric->name << " counter\n" << metric->name << " " << metric->counter.get() << "\n";
+        } else {
+            double value = metric->compute ? metric->compute() : metric->gauge.get();
+            out << "# TYPE " << metric->name << " gauge\n" << metric->name << " " << value << "\n";
+        }
+    }
+    return out.str();
+}
+
+// EnvMetrics Implementation
+EnvMetrics::EnvMetrics(MetricsRegistry& registry)
+    : steps(registry.counter("mm_env_steps_total", "Environment steps taken")),
+      episodes(registry.counter("mm_env_episodes_total", "Episodes finished")),
+      score(registry.counter("mm_env_score_total", "Score summed over finished episodes")),
+      stuck_cars(registry.gauge("mm_env_stuck_cars", "Cars stuck past game_over_stuck_steps right now")) {
+    registry.rate("mm_env_steps_per_second", "Steps per second since the previous export", steps);
+    registry.rate("mm_env_episodes_per_second", "Episodes per second since the previous export", episodes);
+    MetricCounter& score_total = score;
+    MetricCounter& episode_total = episodes;
+    registry.computed_gauge("mm_env_mean_score", "Mean score of finished episodes", [&score_total, &episode_total]() {
+        uint64_t finished = episode_total.get();
+        return finished ? static_cast<double>(score_total.get()) / finished : 0.0;
+    });
+}
+
+// MetricsExporter Implementation
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry, int interval_ms)
+    : registry(registry), interval(interval_ms), listen_fd(-1), stopping(false) {}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start(const std::string& path, int port) {
+    stop();
+    file_path = path;
+    if (port > 0) {
+        listen_fd = listen_on("127.0.0.1:" + std::to_string(port));
+        if (listen_fd < 0) return false;
+    }
+    if (!file_path.empty() && !write_file()) {
+        stop();
+        return false;
+    }
+    stopping.store(false);
+    thread = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (thread.joinable()) {
+        stopping.store(true);
+        thread.join();
+        if (!file_path.empty()) {
+            write_file();
+        }
+    }
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        listen_fd = -1;
+    }
+}
+
+void MetricsExporter::run() {
+    auto next_write = std::chrono::steady_clock::now() + interval;
+    while (!stopping.load()) {
+        auto now = std::chrono::steady_clock::now();
+        if (!file_path.empty() && now >= next_write) {
+            write_file();
+            next_write = now + interval;
+        }
+        
+        int wait_ms = POLL_SLICE_MS;
+        if (!file_path.empty()) {
+            auto until_write = std::chrono::duration_cast<std::chrono::milliseconds>(next_write - now).count();
+            wait_ms = static_cast<int>(std::max<long long>(0, std::min<long long>(wait_ms, until_write)));
+        }
+        if (listen_fd < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+            continue;
+        }
+        
+        pollfd listener = {listen_fd, POLLIN, 0};
+        if (poll(&listener, 1, wait_ms) > 0 && (listener.revents & POLLIN)) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                serve_client(fd);
+                ::close(fd);
+            }
+        }
+    }
+}
+
+bool MetricsExporter::write_file() const {
+    // Written beside the target and renamed over it, so readers never see half a file
+    std::string temp_path = file_path + ".tmp";
+    {
+        std::ofstream out(temp_path);
+        if (!out) {
+            std::cerr << "Failed to open metrics file: " << temp_path << std::endl;
+            return false;
+        }
+        out << registry.render();
+        if (!out) return false;
+    }
+    if (std::rename(temp_path.c_str(), file_path.c_str()) != 0) {
+        std::cerr << "Failed to write metrics file " << file_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::serve_client(int fd) const {
+    // Read the request head (its contents do not matter), but never wait long for it
+    char request[1024];
+    pollfd client = {fd, POLLIN, 0};
+    if (poll(&client, 1, POLL_SLICE_MS) <= 0 || recv(fd, request, sizeof(request), 0) <= 0) return;
+    
+    std::string body = registry.render();
+    std::string response = "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, SEND_FLAGS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
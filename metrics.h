@@ -0,0 +1,110 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Monotonic count; add() is one relaxed atomic increment, safe from any thread
+class MetricCounter {
+private:
+    std::atomic<uint64_t> value{0};
+
+public:
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Value that goes up and down, e.g. a queue depth
+class MetricGauge {
+private:
+    std::atomic<double> value{0.0};
+
+public:
+    void set(double v) { value.store(v, std::memory_order_relaxed); }
+    void add(double delta) { value.fetch_add(delta, std::memory_order_relaxed); }
+    double get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Named metrics rendered in the Prometheus text exposition format. Metrics are
+// registered once, before the run (registration takes a lock); afterwards the
+// returned references stay valid for the registry's lifetime and updating them
+// never locks.
+class MetricsRegistry {
+private:
+    enum class Type { COUNTER, GAUGE };
+    
+    struct Metric {
+        std::string name;
+        std::string help;
+        Type type;
+        MetricCounter counter;
+        MetricGauge gauge;
+        std::function<double()> compute;  // Computed gauges only
+    };
+    
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Metric>> metrics;
+    
+    Metric& add_metric(const std::string& name, const std::string& help, Type type);
+
+public:
+    // Registering a name twice returns the existing metric
+    MetricCounter& counter(const std::string& name, const std::string& help);
+    MetricGauge& gauge(const std::string& name, const std::string& help);
+    // A gauge evaluated on every render, on the rendering thread
+    void computed_gauge(const std::string& name, const std::string& help, std::function<double()> compute);
+    // Per-second change of a counter since the previous render
+    void rate(const std::string& name, const std::string& help, const MetricCounter& counter);
+    
+    std::string render() const;
+};
+
+// What environments feed while attached (MiniMotorwaysEnvironment::set_metrics),
+// registered as mm_env_* along with steps/sec, episodes/sec and the mean score
+struct EnvMetrics {
+    MetricCounter& steps;
+    MetricCounter& episodes;
+    MetricCounter& score;       // Summed over finished episodes
+    MetricGauge& stuck_cars;    // Cars past game_over_stuck_steps, over all attached envs
+    
+    explicit EnvMetrics(MetricsRegistry& registry);
+};
+
+// Background thread that exports a registry every interval: rewritten in full
+// to a file (atomically, through a rename, as the node_exporter textfile
+// collector expects) and/or served over HTTP on a local port.
+class MetricsExporter {
+private:
+    const MetricsRegistry& registry;
+    std::chrono::milliseconds interval;
+    std::string file_path;
+    int listen_fd;
+    std::atomic<bool> stopping;
+    std::thread thread;
+    
+    void run();
+    bool write_file() const;
+    void serve_client(int fd) const;
+
+public:
+    explicit MetricsExporter(const MetricsRegistry& registry, int interval_ms = 1000);
+    ~MetricsExporter();
+    
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+    
+    // Either destination may be left out (empty path, port 0). The HTTP
+    // endpoint listens on 127.0.0.1 only and answers any path.
+    bool start(const std::string& file_path, int port);
+    // Join the thread, writing the file one last time
+    void stop();
+};
+
+#endif // METRICS_H
@@ -1,26 +1,35 @@
 #include "mini_motorways_env.h"
+#include "latency_stats.h"
+#include "metrics.h"
+#include "phase_profiler.h"
+#include "trace.h"
 
 // MiniMotorwaysEnvironment Implementation
 MiniMotorwaysEnvironment::MiniMotorwaysEnvironment() 
-    : grid(GRID_HEIGHT, std::vector<TileType>(GRID_WIDTH, TileType::EMPTY)),
-      score(0), current_step(0), game_over(false), congestion_penalty(0),
-      window(nullptr), rng(std::chrono::steady_clock::now().time_since_epoch().count()),
-      position_dist_x(0, GRID_WIDTH - 1), position_dist_y(0, GRID_HEIGHT - 1),
-      spawn_dist(0.0f, 1.0f) {
+    : grid(GRID_WIDTH, GRID_HEIGHT),
+      active_colors(0), score(0), current_step(0), game_over(false), congestion_penalty(0),
+      last_reward(0.0f),
+      termination_reason(TerminationReason::NONE), congestion_channel(false),
+      window(nullptr), rng(std::chrono::steady_clock::now().time_since_epoch().count()), profiler(nullptr),
+      latency_stats(nullptr), metrics(nullptr), stuck_cars(0), reported_stuck_cars(0) {
     
     // Initialize resources
-    resources["roads"] = 20;
-    resources["motorways"] = 3;
-    resources["bridges"] = 2;
-    resources["roundabouts"] = 1;
-    resources["traffic_lights"] = 2;
-    resources["upgrades"] = 1;
+    reset_resources();
+    
+    free_tiles.reset(GRID_WIDTH, GRID_HEIGHT);
+    intersections.reset(GRID_WIDTH, GRID_HEIGHT);
+    traffic_counters.reset(GRID_WIDTH, GRID_HEIGHT);
+    connectivity.reset(GRID_WIDTH, GRID_HEIGHT);
+    for (auto& field : flow_fields) {
+        field.reset(GRID_WIDTH, GRID_HEIGHT);
+    }
     
     renderer = std::make_unique<Renderer>();
     pathfinder = std::make_unique<PathFinder>();
 }
 
 MiniMotorwaysEnvironment::~MiniMotorwaysEnvironment() {
+    report_stuck_cars(0);
     close();
 }
 
@@ -68,52 +77,173 @@ bool MiniMotorwaysEnvironment::initialize() {
 }
 
 std::vector<float> MiniMotorwaysEnvironment::reset() {
+    return reset(rng());
+}
+
+std::vector<float> MiniMotorwaysEnvironment::reset(unsigned int seed) {
+    {
+        LatencyTimer timer(latency_stats, LatencyOp::RESET);
+        clear_episode();
+        
+        // Initial buildings, from the cache when it has this seed ready
+        const MapLayout* layout = reset_cache ? reset_cache->find(seed) : nullptr;
+        if (!layout) {
+            ResetCache::generate_layout(seed, config, GRID_WIDTH, GRID_HEIGHT, initial_layout);
+            layout = &initial_layout;
+        }
+        ResetCache::seed_episode_rng(layout->seed, rng);
+        restore_layout(*layout);
+    }
+    
+    return get_observation();
+}
+
+std::vector<float> MiniMotorwaysEnvironment::reset_to_map(int index) {
+    if (!map_bank || index < 0 || index >= map_bank->size() ||
+        map_bank->grid_width() != GRID_WIDTH || map_bank->grid_height() != GRID_HEIGHT) {
+        std::cerr << "No map " << index << " in the map bank for a "
+                  << GRID_WIDTH << "x" << GRID_HEIGHT << " grid" << std::endl;
+        return reset();
+    }
+    // Checked here rather than when the bank is opened, so a large bank opens instantly
+    if (!map_bank->valid_map(index)) {
+        std::cerr << "Map " << index << " of the map bank is corrupt" << std::endl;
+        return reset();
+    }
+    
+    {
+        LatencyTimer timer(latency_stats, LatencyOp::RESET);
+        clear_episode();
+        
+        // The layout is read straight from the mapped file
+        const MapLayout& layout = map_bank->map(index);
+        ResetCache::seed_episode_rng(layout.seed, rng);
+        restore_layout(layout);
+    }
+    
+    return get_observation();
+}
+
+void MiniMotorwaysEnvironment::clear_episode() {
     // Reset game state
-    grid.assign(GRID_HEIGHT, std::vector<TileType>(GRID_WIDTH, TileType::EMPTY));
+    grid.clear();
     cars.clear();
     buildings.clear();
+    building_index.clear();
+    spawn_schedule.clear();
+    free_tiles.reset(GRID_WIDTH, GRID_HEIGHT);
+    intersections.reset(GRID_WIDTH, GRID_HEIGHT);
+    traffic_counters.reset(GRID_WIDTH, GRID_HEIGHT);
+    connectivity.reset(GRID_WIDTH, GRID_HEIGHT);
+    for (auto& field : flow_fields) {
+        field.reset(GRID_WIDTH, GRID_HEIGHT);
+    }
     
     score = 0;
     current_step = 0;
     game_over = false;
     congestion_penalty = 0;
+    last_reward = 0.0f;
+    termination_reason = TerminationReason::NONE;
+    gridlock_detector.clear();
+    stuck_cars = 0;
+    report_stuck_cars(0);
     
     // Reset resources
-    resources["roads"] = 20;
-    resources["motorways"] = 3;
-    resources["bridges"] = 2;
-    resources["roundabouts"] = 1;
-    resources["traffic_lights"] = 2;
-    resources["upgrades"] = 1;
-    
-    // Spawn initial buildings
-    spawn_initial_buildings();
-    
-    return get_observation();
+    reset_resources();
+}
+
+void MiniMotorwaysEnvironment::reset_resources() {
+    resources["roads"] = config.roads;
+    resources["motorways"] = config.motorways;
+    resources["bridges"] = config.bridges;
+    resources["roundabouts"] = config.roundabouts;
+    resources["traffic_lights"] = config.traffic_lights;
+    resources["upgrades"] = config.upgrades;
 }
 
 std::vector<float> MiniMotorwaysEnvironment::step(const std::vector<int>& action) {
-    if (game_over || action.size() != 3) {
-        return get_observation();
+    if (action.size() == 3) {
+        advance(action[0], action[1], action[2]);
+    }
+    return get_observation();
+}
+
+void MiniMotorwaysEnvironment::advance(int action_type, int x, int y) {
+    if (game_over) {
+        last_reward = 0.0f;
+        return;
     }
     
+    LatencyTimer timer(latency_stats, LatencyOp::STEP);
+    MM_TRACE_PHASE_SCOPE("step", "env");
     current_step++;
+    int previous_score = score;
+    int previous_congestion = congestion_penalty;
     
     // Execute action
-    if (action[0] < 6) {  // Infrastructure action
-        execute_action(action[0], action[1], action[2]);
+    bool valid_action = true;
+    if (action_type < 6) {  // Infrastructure action
+        PhaseScope phase(profiler, StepPhase::ACTION);
+        MM_TRACE_PHASE_SCOPE("action", "env");
+        valid_action = execute_action(action_type, x, y);
     }
     
     // Simulate traffic
-    simulate_traffic();
+    {
+        PhaseScope phase(profiler, StepPhase::TRAFFIC);
+        MM_TRACE_PHASE_SCOPE("traffic", "env");
+        simulate_traffic();
+    }
     
     // Spawn new cars
-    spawn_cars();
+    {
+        PhaseScope phase(profiler, StepPhase::SPAWNING);
+        MM_TRACE_PHASE_SCOPE("spawning", "env");
+        spawn_cars();
+    }
+    
+    // Grow the city
+    {
+        PhaseScope phase(profiler, StepPhase::GROWTH);
+        MM_TRACE_PHASE_SCOPE("growth", "env");
+        grow_city();
+    }
     
     // Check game over
-    game_over = check_game_over();
+    {
+        PhaseScope phase(profiler, StepPhase::GAME_OVER);
+        MM_TRACE_PHASE_SCOPE("game_over", "env");
+        game_over = check_game_over();
+    }
     
-    return get_observation();
+    if (metrics) {
+        metrics->steps.add();
+        report_stuck_cars(stuck_cars);
+        if (game_over) {
+            metrics->episodes.add();
+            metrics->score.add(score);
+        }
+    }
+    
+    // Completed trips, minus cars stuck in traffic this step and a failed action
+    last_reward = config.trip_reward * (score - previous_score) -
+                  config.stuck_car_penalty * (congestion_penalty - previous_congestion) -
+                  (valid_action ? 0.0f : config.invalid_action_penalty);
+}
+
+void MiniMotorwaysEnvironment::set_metrics(EnvMetrics* env_metrics) {
+    report_stuck_cars(0);
+    metrics = env_metrics;
+    report_stuck_cars(stuck_cars);
+}
+
+void MiniMotorwaysEnvironment::report_stuck_cars(int count) {
+    // Only changes are added, so the shared gauge is the sum over all envs
+    if (metrics && count != reported_stuck_cars) {
+        metrics->stuck_cars.add(count - reported_stuck_cars);
+    }
+    reported_stuck_cars = metrics ? count : 0;
 }
 
 bool MiniMotorwaysEnvironment::execute_action(int action_type, int x, int y) {
@@ -123,49 +253,49 @@ bool MiniMotorwaysEnvironment::execute_action(int action_type, int x, int y) {
     
     switch (action_type) {
         case 0: // Place road
-            if (resources["roads"] > 0 && grid[y][x] == TileType::EMPTY) {
-                grid[y][x] = TileType::ROAD;
+            if (resources["roads"] > 0 && grid.get(x, y) == TileType::EMPTY) {
+                set_tile(Position(x, y), TileType::ROAD);
                 resources["roads"]--;
                 return true;
             }
             break;
             
         case 1: // Place motorway
-            if (resources["motorways"] > 0 && grid[y][x] == TileType::EMPTY) {
-                grid[y][x] = TileType::MOTORWAY;
+            if (resources["motorways"] > 0 && grid.get(x, y) == TileType::EMPTY) {
+                set_tile(Position(x, y), TileType::MOTORWAY);
                 resources["motorways"]--;
                 return true;
             }
             break;
             
         case 2: // Place bridge
-            if (resources["bridges"] > 0 && grid[y][x] == TileType::EMPTY) {
-                grid[y][x] = TileType::BRIDGE;
+            if (resources["bridges"] > 0 && grid.get(x, y) == TileType::EMPTY) {
+                set_tile(Position(x, y), TileType::BRIDGE);
                 resources["bridges"]--;
                 return true;
             }
             break;
             
         case 3: // Place roundabout
-            if (resources["roundabouts"] > 0 && grid[y][x] == TileType::EMPTY) {
-                grid[y][x] = TileType::ROUNDABOUT;
+            if (resources["roundabouts"] > 0 && grid.get(x, y) == TileType::EMPTY) {
+                set_tile(Position(x, y), TileType::ROUNDABOUT);
                 resources["roundabouts"]--;
                 return true;
             }
             break;
             
         case 4: // Place traffic light
-            if (resources["traffic_lights"] > 0 && grid[y][x] == TileType::ROAD) {
-                grid[y][x] = TileType::TRAFFIC_LIGHT;
+            if (resources["traffic_lights"] > 0 && grid.get(x, y) == TileType::ROAD) {
+                set_tile(Position(x, y), TileType::TRAFFIC_LIGHT);
                 resources["traffic_lights"]--;
                 return true;
             }
             break;
             
         case 5: // Remove infrastructure
-            if (grid[y][x] == TileType::ROAD || grid[y][x] == TileType::MOTORWAY) {
-                TileType removed = grid[y][x];
-                grid[y][x] = TileType::EMPTY;
+            if (grid.get(x, y) == TileType::ROAD || grid.get(x, y) == TileType::MOTORWAY) {
+                TileType removed = grid.get(x, y);
+                set_tile(Position(x, y), TileType::EMPTY);
                 
                 // Return resource
                 if (removed == TileType::ROAD) {
@@ -184,37 +314,68 @@ bool MiniMotorwaysEnvironment::execute_action(int action_type, int x, int y) {
 void MiniMotorwaysEnvironment::simulate_traffic() {
     std::vector<std::shared_ptr<Car>> completed_cars;
     
-    for (auto& car : cars) {
-        if (car->completed) continue;
+    // Let queued cars into roundabouts and traffic lights
+    intersections.update(current_step);
+    traffic_counters.begin_step(current_step);
+    
+    if (config.traffic_model == TrafficModel::NAGEL_SCHRECKENBERG) {
+        for (auto& car : cars) {
+            plan_path(*car);
+        }
+        score += nasch_kernel.step(cars, grid, intersections, traffic_counters, rng);
+        gridlock_detector.update(nasch_kernel.get_changed_waits());
         
-        // Find path if needed
-        if (car->path.empty()) {
-            car->path = pathfinder->find_path(car->position, car->destination, grid);
+        for (const auto& car : cars) {
+            if (!car->completed && car->stuck_time > config.congestion_stuck_steps) {
+                congestion_penalty++;
+            }
         }
+    } else {
+        gridlock_detector.clear();  // Cars never block each other here
         
-        // Move car along path
-        if (!car->path.empty() && car->path.size() > 1) {
-            Position next_pos = car->path[1];
+        for (auto& car : cars) {
+            if (car->completed) continue;
             
-            if (can_move_to(next_pos)) {
-                car->position = next_pos;
-                car->path.erase(car->path.begin());
-                car->stuck_time = 0;
-                
-                // Update visual position for smooth animation
-                car->visual_x += (next_pos.x - car->visual_x) * car->speed;
-                car->visual_y += (next_pos.y - car->visual_y) * car->speed;
+            // Find path if needed
+            plan_path(*car);
+            
+            // Move car along path
+            if (!car->path.empty() && car->path.size() > 1) {
+                Position next_pos = car->path[1];
                 
-                // Check if reached destination
-                if (car->position == car->destination) {
-                    car->completed = true;
-                    completed_cars.push_back(car);
-                    score++;
+                // Entering an intersection needs an admission from its approach queue
+                bool blocked = !can_move_to(next_pos);
+                if (!blocked && intersections.is_intersection(next_pos)) {
+                    if (car->intersection_clear) {
+                        car->intersection_clear = false;
+                    } else {
+                        intersections.request_entry(next_pos, car->position, car.get());
+                        blocked = true;
+                    }
                 }
-            } else {
-                car->stuck_time++;
-                if (car->stuck_time > 10) {
-                    congestion_penalty++;
+                
+                if (!blocked) {
+                    car->position = next_pos;
+                    car->path.erase(car->path.begin());
+                    car->stuck_time = 0;
+                    traffic_counters.record_pass(next_pos);
+                    
+                    // Update visual position for smooth animation
+                    car->visual_x += (next_pos.x - car->visual_x) * car->speed;
+                    car->visual_y += (next_pos.y - car->visual_y) * car->speed;
+                    
+                    // Check if reached destination
+                    if (car->position == car->destination) {
+                        car->completed = true;
+                        completed_cars.push_back(car);
+                        score++;
+                    }
+                } else {
+                    car->stuck_time++;
+                    traffic_counters.record_wait(car->position);
+                    if (car->stuck_time > config.congestion_stuck_steps) {
+                        congestion_penalty++;
+                    }
                 }
             }
         }
@@ -226,61 +387,153 @@ void MiniMotorwaysEnvironment::simulate_traffic() {
                cars.end());
 }
 
+void MiniMotorwaysEnvironment::plan_path(Car& car) {
+    // Skipped while the destination is in another component
+    if (car.path.empty() && connectivity.connected(car.position, car.destination, grid)) {
+        PhaseScope phase(profiler, StepPhase::PATHFINDING);
+        MM_TRACE_PHASE_SCOPE("find_path", "env");
+        LatencyTimer timer(latency_stats, LatencyOp::FIND_PATH);
+        car.path = pathfinder->find_path(car.position, car.destination, grid);
+    }
+}
+
 void MiniMotorwaysEnvironment::spawn_cars() {
-    if (current_step % 5 == 0) {  // Spawn every 5 steps
-        for (auto& building : buildings) {
-            if (building.type == TileType::HOUSE && 
-                building.cars_spawned < building.max_cars && 
-                spawn_dist(rng) < 0.3f) {
-                
-                // Find matching business
-                for (const auto& business : buildings) {
-                    if (business.type == TileType::BUSINESS && 
-                        business.color == building.color) {
-                        
-                        auto car = std::make_shared<Car>(
-                            building.position, business.position, building.color);
-                        cars.push_back(car);
-                        building.cars_spawned++;
-                        break;
-                    }
-                }
+    // Only houses whose sampled spawn step has come up are visited
+    spawn_schedule.pop_due(current_step, due_spawns);
+    
+    for (int house_id : due_spawns) {
+        Building& house = buildings[house_id];
+        int c = static_cast<int>(house.color);
+        
+        if (!building_index.businesses(house.color).empty()) {
+            // Head for the nearest reachable business of the colour, or the first one
+            int business_id = flow_fields[c].nearest_source(house.position, grid);
+            if (business_id < 0) {
+                business_id = building_index.businesses(house.color).front();
             }
+            
+            auto car = std::make_shared<Car>(
+                house.position, buildings[business_id].position, house.color);
+            cars.push_back(car);
+            house.cars_spawned++;
         }
+        
+        schedule_spawn(house_id);
     }
 }
 
-void MiniMotorwaysEnvironment::spawn_initial_buildings() {
-    std::vector<CarColor> colors = {CarColor::RED, CarColor::BLUE, CarColor::GREEN};
+void MiniMotorwaysEnvironment::schedule_spawn(int building_id) {
+    const Building& house = buildings[building_id];
+    if (house.cars_spawned >= house.max_cars || house.spawn_probability <= 0.0f) {
+        return;
+    }
     
-    // Spawn houses
-    for (int i = 0; i < 3; i++) {
-        Position pos = find_empty_position();
-        if (pos.x != -1) {
-            buildings.emplace_back(pos, colors[i], TileType::HOUSE);
-            grid[pos.y][pos.x] = TileType::HOUSE;
+    // Opportunities come every spawn_interval steps; the number that fail before
+    // the next car is geometric, so it is drawn once instead of once per opportunity.
+    // A certain spawn never fails, and the distribution requires p < 1.
+    int interval = config.spawn_interval;
+    int failed = 0;
+    if (house.spawn_probability < 1.0f) {
+        std::geometric_distribution<int> failures(house.spawn_probability);
+        failed = failures(rng);
+    }
+    int next_opportunity = (current_step / interval + 1) * interval;
+    spawn_schedule.schedule(building_id, next_opportunity + failed * interval);
+}
+
+void MiniMotorwaysEnvironment::set_tile(const Position& pos, TileType tile) {
+    bool was_passable = grid.is_passable(pos.x, pos.y);
+    grid.set(pos.x, pos.y, tile);
+    
+    if (tile == TileType::ROUNDABOUT || tile == TileType::TRAFFIC_LIGHT) {
+        intersections.add(pos, tile, current_step);
+    } else if (intersections.is_intersection(pos)) {
+        intersections.remove(pos);
+    }
+    
+    // Only passability changes matter to the indexes
+    bool passable = TileGrid::is_passable(tile);
+    if (passable && !was_passable) {
+        free_tiles.erase(pos);
+        connectivity.add_tile(pos, grid);
+        for (auto& field : flow_fields) {
+            field.add_tile(pos, grid);
+        }
+    } else if (!passable && was_passable) {
+        free_tiles.insert(pos);
+        connectivity.remove_tile();
+        for (auto& field : flow_fields) {
+            field.remove_tile();
         }
     }
+}
+
+bool MiniMotorwaysEnvironment::spawn_building(TileType type, CarColor color) {
+    Position pos = find_empty_position();
+    if (pos.x == -1) {
+        return false;
+    }
+    
+    add_building(pos, type, color);
+    return true;
+}
+
+void MiniMotorwaysEnvironment::add_building(const Position& pos, TileType type, CarColor color) {
+    int building_id = buildings.size();
+    buildings.emplace_back(pos, color, type);
+    buildings.back().max_cars = config.max_cars_per_house;
+    buildings.back().spawn_probability = config.spawn_probability;
+    building_index.add(building_id, buildings.back());
+    set_tile(pos, type);
+    
+    if (type == TileType::BUSINESS) {
+        flow_fields[static_cast<int>(color)].add_source(pos, building_id, grid);
+    } else if (type == TileType::HOUSE) {
+        schedule_spawn(building_id);
+    }
+}
+
+void MiniMotorwaysEnvironment::restore_layout(const MapLayout& layout) {
+    active_colors = layout.active_colors;
     
-    // Spawn businesses
-    for (int i = 0; i < 2; i++) {
-        Position pos = find_empty_position();
-        if (pos.x != -1) {
-            buildings.emplace_back(pos, colors[i], TileType::BUSINESS);
-            grid[pos.y][pos.x] = TileType::BUSINESS;
+    for (int i = 0; i < layout.building_count; i++) {
+        const MapLayout::PackedBuilding& building = layout.buildings[i];
+        add_building(Position(building.x, building.y), static_cast<TileType>(building.type),
+                     static_cast<CarColor>(building.color));
+    }
+}
+
+void MiniMotorwaysEnvironment::grow_city() {
+    std::uniform_int_distribution<int> color_dist(0, active_colors - 1);
+    
+    if (current_step % config.business_growth_interval == 0) {
+        // Serve a colour whose houses have nowhere to go, else open a new colour
+        int color = -1;
+        for (int c = 0; c < active_colors && color < 0; c++) {
+            if (building_index.businesses(static_cast<CarColor>(c)).empty()) {
+                color = c;
+            }
+        }
+        if (color < 0 && active_colors < NUM_CAR_COLORS) {
+            color = active_colors++;
+            spawn_building(TileType::HOUSE, static_cast<CarColor>(color));
+        }
+        if (color < 0) {
+            color = color_dist(rng);
         }
+        spawn_building(TileType::BUSINESS, static_cast<CarColor>(color));
+    }
+    
+    if (current_step % config.house_growth_interval == 0) {
+        spawn_building(TileType::HOUSE, static_cast<CarColor>(color_dist(rng)));
     }
 }
 
 Position MiniMotorwaysEnvironment::find_empty_position() {
-    for (int attempts = 0; attempts < 100; attempts++) {
-        int x = position_dist_x(rng);
-        int y = position_dist_y(rng);
-        if (grid[y][x] == TileType::EMPTY) {
-            return Position(x, y);
-        }
+    if (free_tiles.size() == 0) {
+        return Position(-1, -1);  // No empty position found
     }
-    return Position(-1, -1);  // No empty position found
+    return free_tiles.sample(rng);
 }
 
 bool MiniMotorwaysEnvironment::is_valid_position(const Position& pos) const {
@@ -290,21 +543,26 @@ bool MiniMotorwaysEnvironment::is_valid_position(const Position& pos) const {
 bool MiniMotorwaysEnvironment::can_move_to(const Position& pos) const {
     if (!is_valid_position(pos)) return false;
     
-    TileType tile = grid[pos.y][pos.x];
-    return tile == TileType::ROAD || tile == TileType::MOTORWAY || 
-           tile == TileType::BRIDGE || tile == TileType::ROUNDABOUT ||
-           tile == TileType::TRAFFIC_LIGHT || tile == TileType::HOUSE || 
-           tile == TileType::BUSINESS;
+    return grid.is_passable(pos.x, pos.y);
 }
 
 bool MiniMotorwaysEnvironment::check_game_over() {
+    // A gridlock never clears, so stop rather than wait for the stuck-car limit
+    if (config.terminate_on_gridlock && gridlock_detector.gridlocked()) {
+        termination_reason = TerminationReason::GRIDLOCK;
+        return true;
+    }
+    
     // Count stuck cars
-    int stuck_cars = 0;
+    stuck_cars = 0;
     for (const auto& car : cars) {
-        if (car->stuck_time > 20) stuck_cars++;
+        if (car->stuck_time > config.game_over_stuck_steps) stuck_cars++;
     }
     
-    if (stuck_cars > 10) return true;
+    if (stuck_cars > config.max_stuck_cars) {
+        termination_reason = TerminationReason::STUCK_CARS;
+        return true;
+    }
     
     // Check if out of resources with too many cars
     int total_resources = 0;
@@ -312,52 +570,124 @@ bool MiniMotorwaysEnvironment::check_game_over() {
         total_resources += value;
     }
     
-    if (total_resources == 0 && cars.size() > 15) return true;
-    if (current_step >= MAX_STEPS) return true;
+    if (total_resources == 0 && static_cast<int>(cars.size()) > config.max_cars_without_resources) {
+        termination_reason = TerminationReason::OUT_OF_RESOURCES;
+        return true;
+    }
+    if (current_step >= config.max_steps) {
+        termination_reason = TerminationReason::MAX_STEPS;
+        return true;
+    }
     
     return false;
 }
 
 std::vector<float> MiniMotorwaysEnvironment::get_observation() const {
-    std::vector<float> observation;
-    
-    // Flatten grid (20x20 = 400 values)
-    for (int y = 0; y < GRID_HEIGHT; y++) {
-        for (int x = 0; x < GRID_WIDTH; x++) {
-            observation.push_back(static_cast<float>(static_cast<int>(grid[y][x])) / 7.0f);
+    std::vector<float> observation(get_observation_size());
+    write_observation(observation.data());
+    return observation;
+}
+
+void MiniMotorwaysEnvironment::write_observation(float* out) const {
+    PhaseScope phase(profiler, StepPhase::OBSERVATION);
+    MM_TRACE_PHASE_SCOPE("observation", "env");
+    LatencyTimer timer(latency_stats, LatencyOp::OBSERVATION);
+    
+    // Flatten grid (20x20 = 400 values); only chunks changed since the last call are unpacked
+    if (observed_chunk_versions.size() != static_cast<size_t>(grid.chunks_x() * grid.chunks_y())) {
+        grid_observation.assign(GRID_WIDTH * GRID_HEIGHT, 0.0f);
+        observed_chunk_versions.assign(grid.chunks_x() * grid.chunks_y(), UINT32_MAX);
+    }
+    for (int cy = 0; cy < grid.chunks_y(); cy++) {
+        for (int cx = 0; cx < grid.chunks_x(); cx++) {
+            uint32_t& seen = observed_chunk_versions[cy * grid.chunks_x() + cx];
+            if (seen == grid.chunk_version(cx, cy)) continue;
+            
+            grid.unpack_chunk(cx, cy,
+                              &grid_observation[(cy * GRID_WIDTH + cx) * TileGrid::CHUNK_SIZE],
+                              GRID_WIDTH);
+            seen = grid.chunk_version(cx, cy);
         }
     }
+    std::copy(grid_observation.begin(), grid_observation.end(), out);
+    out += GRID_WIDTH * GRID_HEIGHT;
     
-    // Car density layer (20x20 = 400 values)
-    std::vector<std::vector<int>> car_density(GRID_HEIGHT, std::vector<int>(GRID_WIDTH, 0));
+    // Car density layer (20x20 = 400 values), counted in place then scaled
+    std::fill(out, out + GRID_WIDTH * GRID_HEIGHT, 0.0f);
     for (const auto& car : cars) {
         if (car->position.x >= 0 && car->position.x < GRID_WIDTH &&
             car->position.y >= 0 && car->position.y < GRID_HEIGHT) {
-            car_density[car->position.y][car->position.x]++;
+            out[car->position.y * GRID_WIDTH + car->position.x] += 1.0f;
         }
     }
-    
-    for (int y = 0; y < GRID_HEIGHT; y++) {
-        for (int x = 0; x < GRID_WIDTH; x++) {
-            observation.push_back(std::min(car_density[y][x] / 5.0f, 1.0f));
-        }
+    for (int tile = 0; tile < GRID_WIDTH * GRID_HEIGHT; tile++) {
+        out[tile] = std::min(out[tile] / 5.0f, 1.0f);
     }
+    out += GRID_WIDTH * GRID_HEIGHT;
     
     // Resources (6 values)
-    observation.push_back(resources.at("roads") / 20.0f);
-    observation.push_back(resources.at("motorways") / 3.0f);
-    observation.push_back(resources.at("bridges") / 2.0f);
-    observation.push_back(resources.at("roundabouts") / 1.0f);
-    observation.push_back(resources.at("traffic_lights") / 2.0f);
-    observation.push_back(resources.at("upgrades") / 1.0f);
+    *out++ = resources.at("roads") / 20.0f;
+    *out++ = resources.at("motorways") / 3.0f;
+    *out++ = resources.at("bridges") / 2.0f;
+    *out++ = resources.at("roundabouts") / 1.0f;
+    *out++ = resources.at("traffic_lights") / 2.0f;
+    *out++ = resources.at("upgrades") / 1.0f;
     
     // Game stats (4 values)
-    observation.push_back(score / 100.0f);  // Normalize score
-    observation.push_back(cars.size() / 50.0f);  // Normalize car count
-    observation.push_back(congestion_penalty / 100.0f);  // Normalize congestion
-    observation.push_back(current_step / static_cast<float>(MAX_STEPS));
+    *out++ = score / 100.0f;  // Normalize score
+    *out++ = cars.size() / 50.0f;  // Normalize car count
+    *out++ = congestion_penalty / 100.0f;  // Normalize congestion
+    *out++ = current_step / static_cast<float>(config.max_steps);
+    
+    // Optional congestion layer (20x20 = 400 values)
+    if (congestion_channel) {
+        for (int tile = 0; tile < GRID_WIDTH * GRID_HEIGHT; tile++) {
+            *out++ = traffic_counters.congestion(tile);
+        }
+    }
+}
+
+void MiniMotorwaysEnvironment::write_action_mask(uint8_t* out) const {
+    const int tiles = GRID_WIDTH * GRID_HEIGHT;
+    
+    // Mirrors execute_action(): a piece in stock and the right tile underneath
+    const uint8_t roads = resources.at("roads") > 0;
+    const uint8_t motorways = resources.at("motorways") > 0;
+    const uint8_t bridges = resources.at("bridges") > 0;
+    const uint8_t roundabouts = resources.at("roundabouts") > 0;
+    const uint8_t traffic_lights = resources.at("traffic_lights") > 0;
+    
+    for (int tile = 0; tile < tiles; tile++) {
+        TileType type = grid.get(tile % GRID_WIDTH, tile / GRID_WIDTH);
+        uint8_t empty = type == TileType::EMPTY;
+        out[0 * tiles + tile] = roads & empty;
+        out[1 * tiles + tile] = motorways & empty;
+        out[2 * tiles + tile] = bridges & empty;
+        out[3 * tiles + tile] = roundabouts & empty;
+        out[4 * tiles + tile] = traffic_lights & (type == TileType::ROAD);
+        out[5 * tiles + tile] = type == TileType::ROAD || type == TileType::MOTORWAY;
+    }
+    std::fill(out + 6 * tiles, out + 7 * tiles, 1);
+}
+
+int MiniMotorwaysEnvironment::get_observation_size() const {
+    int layers = congestion_channel ? 3 : 2;
+    return layers * GRID_WIDTH * GRID_HEIGHT + 10;
+}
+
+bool MiniMotorwaysEnvironment::write_traffic_stats(const std::string& filepath) const {
+    std::ofstream out(filepath);
+    if (!out) {
+        std::cerr << "Failed to open traffic stats file: " << filepath << std::endl;
+        return false;
+    }
     
-    return observation;
+    traffic_counters.write_csv(out);
+    return true;
+}
+
+void MiniMotorwaysEnvironment::set_heatmap_overlay(bool enabled) {
+    renderer->set_heatmap_overlay(enabled);
 }
 
 void MiniMotorwaysEnvironment::render() {
@@ -390,7 +720,7 @@ void MiniMotorwaysEnvironment::close() {
 
 // PathFinder Implementation
 std::vector<Position> PathFinder::find_path(const Position& start, const Position& goal,
-                                          const std::vector<std::vector<TileType>>& grid) const {
+                                          const TileGrid& grid) const {
     
     // Comparator for priority queue
     struct NodeComparator {
@@ -427,19 +757,13 @@ std::vector<Position> PathFinder::find_path(const Position& start, const Positio
         for (const auto& dir : directions) {
             Position neighbor(current.pos.x + dir.x, current.pos.y + dir.y);
             
-            if (neighbor.x < 0 || neighbor.x >= grid[0].size() ||
-                neighbor.y < 0 || neighbor.y >= grid.size()) continue;
+            if (neighbor.x < 0 || neighbor.x >= grid.width() ||
+                neighbor.y < 0 || neighbor.y >= grid.height()) continue;
             
             if (closed_set.count(neighbor)) continue;
             
             // Check if tile is passable
-            TileType tile = grid[neighbor.y][neighbor.x];
-            bool passable = (tile == TileType::ROAD || tile == TileType::MOTORWAY || 
-                           tile == TileType::BRIDGE || tile == TileType::ROUNDABOUT ||
-                           tile == TileType::TRAFFIC_LIGHT || tile == TileType::HOUSE || 
-                           tile == TileType::BUSINESS);
-            
-            if (!passable) continue;
+            if (!grid.is_passable(neighbor.x, neighbor.y)) continue;
             
             int tentative_g = g_score[current.pos] + 1;
             
@@ -7,6 +7,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "config.h"
+#include "tile_grid.h"
+
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <random>
@@ -17,23 +21,17 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <atomic>
+#include <thread>
 
 // Forward declarations
 struct Car;
 struct Building;
 class Renderer;
 class PathFinder;
-
-enum class TileType : int {
-    EMPTY = 0,
-    HOUSE = 1,
-    BUSINESS = 2,
-    ROAD = 3,
-    MOTORWAY = 4,
-    BRIDGE = 5,
-    ROUNDABOUT = 6,
-    TRAFFIC_LIGHT = 7
-};
+class PhaseProfiler;
+class LatencyStats;
+struct EnvMetrics;
 
 enum class CarColor : int {
     RED = 0,
@@ -44,6 +42,8 @@ enum class CarColor : int {
     ORANGE = 5
 };
 
+static const int NUM_CAR_COLORS = 6;
+
 struct Position {
     int x, y;
     
@@ -77,10 +77,17 @@ struct Car {
     bool completed;
     float visual_x, visual_y;  // For smooth animation
     float speed;
+    int velocity;                 // Tiles per step (Nagel-Schreckenberg model)
+    bool queued_at_intersection;  // Waiting in an approach queue
+    bool intersection_clear;      // Admitted into the next intersection tile
+    Car* waiting_for;             // Car on the tile this one is blocked by, if any
+    uint32_t wait_mark;           // Gridlock detector walk stamp
     
     Car(Position pos, Position dest, CarColor col) 
         : position(pos), destination(dest), color(col), stuck_time(0), 
-          completed(false), visual_x(pos.x), visual_y(pos.y), speed(0.1f) {}
+          completed(false), visual_x(pos.x), visual_y(pos.y), speed(0.1f),
+          velocity(0), queued_at_intersection(false), intersection_clear(false),
+          waiting_for(nullptr), wait_mark(0) {}
 };
 
 struct Building {
@@ -89,39 +96,486 @@ struct Building {
     TileType type;
     int cars_spawned;
     int max_cars;
+    float spawn_probability;  // Chance of a car at each spawn opportunity
     
     Building(Position pos, CarColor col, TileType t) 
-        : position(pos), color(col), type(t), cars_spawned(0), max_cars(5) {}
+        : position(pos), color(col), type(t), cars_spawned(0), max_cars(5),
+          spawn_probability(0.3f) {}
+};
+
+// Calendar (bucket) queue of building ids keyed by the step of their next car
+// spawn. Buckets form a power-of-two ring indexed by step; an entry further out
+// than one lap stays in its bucket until its step comes round.
+class SpawnScheduler {
+private:
+    static const int RING_SIZE = 64;
+    
+    struct Entry {
+        int step;
+        int building_id;
+    };
+    
+    std::vector<Entry> buckets[RING_SIZE];
+
+public:
+    void clear();
+    void schedule(int building_id, int step);
+    
+    // Replace `due` with the ids scheduled exactly at `step`, in insertion order
+    void pop_due(int step, std::vector<int>& due);
+};
+
+// Per-colour lists of building ids (indices into the buildings vector)
+class BuildingIndex {
+private:
+    std::vector<int> house_ids[NUM_CAR_COLORS];
+    std::vector<int> business_ids[NUM_CAR_COLORS];
+
+public:
+    void clear();
+    void add(int building_id, const Building& building);
+    
+    const std::vector<int>& houses(CarColor color) const { return house_ids[static_cast<int>(color)]; }
+    const std::vector<int>& businesses(CarColor color) const { return business_ids[static_cast<int>(color)]; }
+};
+
+// EMPTY tiles as a dense array plus a tile -> slot map. Erasing swaps the last
+// entry into the hole, so insert, erase and uniform sampling are all O(1).
+// Like the other per-tile indexes this is dense, two ints per map tile.
+class FreeTileSet {
+private:
+    int width;
+    std::vector<int> tiles;
+    std::vector<int> slot_of;  // -1 when the tile is not free
+
+public:
+    FreeTileSet() : width(0) {}
+    
+    void reset(int grid_width, int grid_height);  // Every tile starts free
+    void insert(const Position& pos);
+    void erase(const Position& pos);
+    int size() const { return tiles.size(); }
+    
+    Position sample(std::mt19937& rng) const;  // Requires size() > 0
+};
+
+// Connected components of passable tiles. New tiles are merged in with
+// union-find; removals only mark the labels stale for a lazy rebuild.
+class ConnectivityLabels {
+private:
+    int width, height;
+    bool stale;
+    std::vector<int> parent;
+    
+    int find(int tile);
+    void unite(int a, int b);
+    void rebuild(const TileGrid& grid);
+
+public:
+    ConnectivityLabels() : width(0), height(0), stale(false) {}
+    
+    void reset(int grid_width, int grid_height);
+    void add_tile(const Position& pos, const TileGrid& grid);
+    void remove_tile() { stale = true; }
+    bool connected(const Position& a, const Position& b, const TileGrid& grid);
+};
+
+// Distance from every tile to the nearest business of one colour, plus that
+// business's id. New tiles and businesses relax the field outward from where
+// they appear; removals mark it stale for a lazy multi-source BFS rebuild.
+class FlowField {
+public:
+    static constexpr uint16_t UNREACHABLE = 0xFFFF;
+
+private:
+    int width, height;
+    bool stale;
+    std::vector<uint16_t> dist;
+    std::vector<int> nearest;
+    std::vector<std::pair<Position, int>> sources;
+    std::vector<int> frontier;
+    
+    void relax(const TileGrid& grid);
+    void rebuild(const TileGrid& grid);
+
+public:
+    FlowField() : width(0), height(0), stale(false) {}
+    
+    void reset(int grid_width, int grid_height);
+    void add_source(const Position& pos, int building_id, const TileGrid& grid);
+    void add_tile(const Position& pos, const TileGrid& grid);
+    void remove_tile() { stale = true; }
+    bool has_sources() const { return !sources.empty(); }
+    
+    // Id of the nearest reachable business, or -1
+    int nearest_source(const Position& pos, const TileGrid& grid);
+};
+
+// Roundabouts and traffic lights meter cars in from per-approach FIFO queues
+// (fixed ring buffers). Traffic lights alternate north-south / east-west green
+// phases driven by a timing wheel; roundabouts admit round-robin, and an
+// approach yields when the approach on its left has just let a car in.
+// Only intersections with queued cars are visited each step.
+class IntersectionModel {
+public:
+    static const int APPROACHES = 4;  // North, east, south, west
+    static const int QUEUE_CAPACITY = 8;
+    static const int LIGHT_PHASE_STEPS = 8;
+
+private:
+    struct ApproachQueue {
+        Car* cars[QUEUE_CAPACITY];
+        int head;
+        int count;
+    };
+    
+    struct Intersection {
+        Position pos;
+        TileType type;
+        bool alive;
+        bool active;
+        int green_axis;     // 0 = north-south, 1 = east-west
+        int next_approach;  // Roundabout round-robin start
+        ApproachQueue queues[APPROACHES];
+    };
+    
+    int width;
+    std::vector<Intersection> intersections;
+    std::vector<int> id_at;  // Tile -> intersection id, -1 for none
+    std::vector<int> active_ids;
+    std::vector<int> phase_wheel[LIGHT_PHASE_STEPS];  // Lights switching at step % LIGHT_PHASE_STEPS
+    
+    static bool pop(ApproachQueue& queue, Car*& car);
+    int admit_traffic_light(Intersection& intersection);
+    int admit_roundabout(Intersection& intersection);
+
+public:
+    IntersectionModel() : width(0) {}
+    
+    void reset(int grid_width, int grid_height);
+    void add(const Position& pos, TileType type, int current_step);
+    void remove(const Position& pos);
+    bool is_intersection(const Position& pos) const { return id_at[pos.y * width + pos.x] >= 0; }
+    
+    // Queue a car that wants to enter `pos` from the adjacent tile `from`.
+    // Returns false (car keeps retrying) while that approach queue is full.
+    bool request_entry(const Position& pos, const Position& from, Car* car);
+    
+    // Switch due signal phases and admit queued cars for this step
+    void update(int current_step);
+    
+    int active_count() const { return active_ids.size(); }
+};
+
+// Per-tile traffic counters in flat arrays: cars entering a tile (passes), car-steps
+// spent waiting on it, and the most cars seen waiting on it in one step.
+// Passes and waits halve every HALF_LIFE_STEPS; instead of a pass over the map
+// each step, a tile is decayed from its last-touched step when next touched or read.
+class TrafficCounters {
+public:
+    static constexpr float HALF_LIFE_STEPS = 50.0f;
+    static const int DECAY_TABLE_SIZE = 400;  // Older counts (< 1/256) drop to zero
+
+private:
+    int width;
+    int current_step;
+    std::vector<float> passes;
+    std::vector<float> waits;
+    std::vector<int> last_step;
+    std::vector<uint16_t> max_queue;
+    std::vector<uint16_t> waiting_now;  // Cars waiting on the tile during wait_step
+    std::vector<int> wait_step;
+    std::vector<float> decay_table;
+    
+    float decay(int elapsed) const {
+        return elapsed < DECAY_TABLE_SIZE ? decay_table[elapsed] : 0.0f;
+    }
+    
+    void touch(int tile) {
+        if (last_step[tile] != current_step) {
+            float factor = decay(current_step - last_step[tile]);
+            passes[tile] *= factor;
+            waits[tile] *= factor;
+            last_step[tile] = current_step;
+        }
+    }
+
+public:
+    TrafficCounters() : width(0), current_step(0) {}
+    
+    void reset(int grid_width, int grid_height);
+    void begin_step(int step) { current_step = step; }
+    
+    void record_pass(const Position& pos) {
+        int tile = pos.y * width + pos.x;
+        touch(tile);
+        passes[tile] += 1.0f;
+    }
+    
+    void record_wait(const Position& pos) {
+        int tile = pos.y * width + pos.x;
+        touch(tile);
+        waits[tile] += 1.0f;
+        if (wait_step[tile] != current_step) {
+            wait_step[tile] = current_step;
+            waiting_now[tile] = 0;
+        }
+        waiting_now[tile]++;
+        max_queue[tile] = std::max(max_queue[tile], waiting_now[tile]);
+    }
+    
+    // Decayed counts as of the current step
+    float get_passes(int tile) const { return passes[tile] * decay(current_step - last_step[tile]); }
+    float get_waits(int tile) const { return waits[tile] * decay(current_step - last_step[tile]); }
+    int get_max_queue(int tile) const { return max_queue[tile]; }
+    
+    // Share of recent traffic on the tile that was waiting, in [0, 1)
+    float congestion(int tile) const {
+        float w = get_waits(tile);
+        return w / (w + get_passes(tile) + 1.0f);
+    }
+    
+    // CSV rows (x,y,passes,waits,max_queue) for every tile that has seen traffic
+    void write_csv(std::ostream& out) const;
+};
+
+// Nagel-Schreckenberg cellular automaton run along the cars' planned paths.
+// Each pass gathers the moving cars into flat arrays so the accelerate, brake
+// and dawdle rules run as branch-free loops the compiler can vectorise; only
+// the gap scan and the final move touch the grid.
+class NagelSchreckenbergKernel {
+public:
+    static const int MAX_VELOCITY = 4;
+    static constexpr float DAWDLE_PROBABILITY = 0.1f;
+    
+    static int speed_limit(TileType tile);
+
+private:
+    std::vector<uint16_t> occupancy;  // Cars per tile, not counted on buildings
+    std::vector<Car*> occupant;       // Last car to enter each counted tile
+    std::vector<Car*> moving;
+    std::vector<Car*> changed_waits;
+    std::vector<int> velocity;
+    std::vector<int> limit;
+    std::vector<int> gap;
+    std::vector<int> dawdle;
+    
+    int free_tiles_ahead(Car& car, int max_gap, const TileGrid& grid,
+                         IntersectionModel& intersections);
+
+public:
+    // Advance every car that has a planned path. Sets stuck_time, completed and
+    // waiting_for on the cars, records passes and waits in `counters`, and
+    // returns how many reached their destination.
+    int step(std::vector<std::shared_ptr<Car>>& cars, const TileGrid& grid,
+             IntersectionModel& intersections, TrafficCounters& counters, std::mt19937& rng);
+    
+    // Cars whose waiting_for was set to a different car during the last step
+    const std::vector<Car*>& get_changed_waits() const { return changed_waits; }
+};
+
+// Wait-for graph of blocked cars. A car waits on at most one car (the one on
+// the tile it needs next), so a gridlock is a cycle in a functional graph.
+// Any new cycle must use an edge that changed this step, so walks start from
+// those cars only and stop at anything an earlier walk already covered.
+class GridlockDetector {
+private:
+    uint32_t walk_counter;
+    Car* cycle_member;  // A car on the last detected cycle
+    
+    bool on_cycle(Car* car);
+
+public:
+    GridlockDetector() : walk_counter(0), cycle_member(nullptr) {}
+    
+    void clear() { cycle_member = nullptr; }
+    
+    // Re-check the known cycle, then look for new ones; returns whether one exists
+    bool update(const std::vector<Car*>& changed_waits);
+    bool gridlocked() const { return cycle_member != nullptr; }
+};
+
+// The initial buildings of one seed in placement order, packed into a
+// fixed-size POD with a fixed layout so map bank files store it as-is.
+struct MapLayout {
+    static const int MAX_BUILDINGS = 64;
+    
+    struct PackedBuilding {
+        uint8_t x, y;
+        uint8_t type;   // TileType
+        uint8_t color;  // CarColor
+    };
+    
+    uint32_t seed;
+    uint16_t building_count;
+    uint8_t active_colors;
+    uint8_t reserved;
+    PackedBuilding buildings[MAX_BUILDINGS];
+};
+
+// Initial layouts for the seeds [first_seed, first_seed + count), generated in
+// seed order by a background thread so resets never wait on map generation.
+// A layout can be read once `generated` has passed it; the cache must be built
+// with the same Config as the environments that use it. Only layouts are kept:
+// reset(seed) replays one through add_building() and reseeds the episode RNG
+// from layout.seed, as reset_to_map() does for map-bank layouts.
+//
+// Nothing is restored by memcpy. What a hit saves is generate_layout(), about
+// 7 us of a 21 us reset on the 20x20 map, so a cached reset takes about 12 us.
+// Most of the rest is seeding and twisting the episode RNG (about 6 us) and
+// clearing the per-tile indexes (about 2 us); copying snapshots of those
+// indexes back would cost some 30 KB per seed.
+class ResetCache {
+private:
+    unsigned first_seed;
+    std::vector<MapLayout> layouts;
+    std::atomic<int> generated;
+    std::atomic<bool> stopping;
+    std::thread worker;
+
+public:
+    ResetCache(const Config& config, int grid_width, int grid_height,
+               unsigned first_seed, int count);
+    ~ResetCache();
+    
+    ResetCache(const ResetCache&) = delete;
+    ResetCache& operator=(const ResetCache&) = delete;
+    
+    // The layout for `seed`, or nullptr when it is out of range or not generated yet
+    const MapLayout* find(unsigned seed) const;
+    int ready_count() const { return generated.load(std::memory_order_acquire); }
+    // Block until every layout is generated and the generating thread has exited,
+    // e.g. before fork(), which would not copy the thread into the child
+    void wait();
+    
+    // Lay out the initial buildings of `seed` on an empty map. The result
+    // depends only on the seed, the config and the map size.
+    static void generate_layout(unsigned seed, const Config& config, int grid_width, int grid_height,
+                                MapLayout& layout);
+    static void seed_episode_rng(unsigned seed, std::mt19937& episode_rng);
+};
+
+// Read-only map bank: a header followed by MapLayout records, generated offline
+// (see the genmaps mode). The file is memory-mapped, so every process and thread
+// using a bank shares one copy through the page cache and layouts are read in place.
+// Opening only checks the header; a record is checked when an episode starts from it.
+class MapBank {
+public:
+    static const uint32_t MAGIC = 0x50414D4D;  // "MMAP" in a little-endian file
+    static const uint32_t VERSION = 2;
+    
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t record_size;  // sizeof(MapLayout)
+        uint32_t grid_width;
+        uint32_t grid_height;
+        uint32_t map_count;
+        uint64_t config_hash;  // config_hash() of the Config the maps were generated with
+    };
+
+private:
+    void* mapping;
+    size_t mapping_size;
+    const Header* header;
+    const MapLayout* layouts;
+
+public:
+    MapBank() : mapping(nullptr), mapping_size(0), header(nullptr), layouts(nullptr) {}
+    ~MapBank();
+    
+    MapBank(const MapBank&) = delete;
+    MapBank& operator=(const MapBank&) = delete;
+    
+    // Fails unless the bank was generated with `config`
+    bool open(const std::string& filepath, const Config& config);
+    void close();
+    
+    int size() const { return header ? static_cast<int>(header->map_count) : 0; }
+    int grid_width() const { return header ? static_cast<int>(header->grid_width) : 0; }
+    int grid_height() const { return header ? static_cast<int>(header->grid_height) : 0; }
+    const MapLayout& map(int index) const { return layouts[index]; }
+    // Whether map `index` can be laid out without reaching outside the grid or the enums
+    bool valid_map(int index) const;
+    
+    // Generate the layouts of seeds [first_seed, first_seed + count) into a new bank file
+    static bool write(const std::string& filepath, const Config& config, int grid_width,
+                      int grid_height, unsigned first_seed, int count);
+};
+
+enum class TerminationReason : int {
+    NONE = 0,
+    STUCK_CARS = 1,        // Too many cars stuck for too long
+    OUT_OF_RESOURCES = 2,  // No pieces left with too many cars on the map
+    MAX_STEPS = 3,         // Truncated at the step limit
+    GRIDLOCK = 4           // Truncated early: a cycle of cars blocking each other
 };
 
 class MiniMotorwaysEnvironment {
 private:
     static const int GRID_WIDTH = 20;
     static const int GRID_HEIGHT = 20;
-    static const int MAX_STEPS = 1000;
+    
+    // Scenario rules; changes take full effect from the next reset()
+    Config config;
     
     // Game state
-    std::vector<std::vector<TileType>> grid;
+    TileGrid grid;
     std::vector<std::shared_ptr<Car>> cars;
     std::vector<Building> buildings;
     std::unordered_map<std::string, int> resources;
+    int active_colors;
+    
+    // Pre-generated initial layouts, shared between environments
+    std::shared_ptr<const ResetCache> reset_cache;
+    std::shared_ptr<const MapBank> map_bank;
+    MapLayout initial_layout;  // Generated here when the cache does not have the seed
+    
+    // Incremental indexes, kept in step with every tile change through set_tile()
+    FreeTileSet free_tiles;
+    BuildingIndex building_index;
+    ConnectivityLabels connectivity;
+    FlowField flow_fields[NUM_CAR_COLORS];
+    SpawnScheduler spawn_schedule;
+    std::vector<int> due_spawns;
+    IntersectionModel intersections;
+    TrafficCounters traffic_counters;
+    
+    // Traffic model
+    NagelSchreckenbergKernel nasch_kernel;
+    GridlockDetector gridlock_detector;
     
     // Game metrics
     int score;
     int current_step;
     bool game_over;
     int congestion_penalty;
+    float last_reward;
+    TerminationReason termination_reason;
+    bool congestion_channel;
     
     // OpenGL components
     GLFWwindow* window;
     std::unique_ptr<Renderer> renderer;
     std::unique_ptr<PathFinder> pathfinder;
     
+    // Grid part of the observation, re-unpacked only for chunks whose version changed
+    mutable std::vector<float> grid_observation;
+    mutable std::vector<uint32_t> observed_chunk_versions;
+    
     // Random number generation
     std::mt19937 rng;
-    std::uniform_int_distribution<int> position_dist_x;
-    std::uniform_int_distribution<int> position_dist_y;
-    std::uniform_real_distribution<float> spawn_dist;
+    
+    // Counters per step phase while profiling; not owned
+    PhaseProfiler* profiler;
+    // Step, reset, find_path and observation durations while measuring; not owned
+    LatencyStats* latency_stats;
+    // Live counters for a metrics exporter; not owned
+    EnvMetrics* metrics;
+    int stuck_cars;           // As of the last game-over check
+    int reported_stuck_cars;  // This env's share of metrics->stuck_cars
+    
+    void report_stuck_cars(int count);
 
 public:
     MiniMotorwaysEnvironment();
@@ -129,9 +583,23 @@ public:
     
     // Core RL interface
     bool initialize();
-    std::vector<float> reset();
+    std::vector<float> reset();                   // Uses a seed drawn from the environment's RNG
+    std::vector<float> reset(unsigned int seed);  // The same seed always replays the same episode
     std::vector<float> step(const std::vector<int>& action);
     std::vector<float> get_observation() const;
+    int get_observation_size() const;
+    
+    // Allocation-free forms for batched callers: advance() steps without building
+    // an observation, write_observation() fills get_observation_size() floats
+    void advance(int action_type, int x, int y);
+    void write_observation(float* out) const;
+    float get_last_reward() const { return last_reward; }
+    
+    // Which actions would succeed right now: one byte per (action_type, y, x),
+    // laid out as mask[action_type * tiles + y * width + x]. Type 6 (wait) is always valid.
+    static const int NUM_ACTION_TYPES = 7;
+    int get_action_mask_size() const { return NUM_ACTION_TYPES * GRID_WIDTH * GRID_HEIGHT; }
+    void write_action_mask(uint8_t* out) const;
     bool is_done() const;
     void render();
     void close();
@@ -140,22 +608,63 @@ public:
     bool execute_action(int action_type, int x, int y);
     void simulate_traffic();
     void spawn_cars();
+    void schedule_spawn(int building_id);
     bool check_game_over();
     
     // Utility functions
     Position find_empty_position();
     bool is_valid_position(const Position& pos) const;
     bool can_move_to(const Position& pos) const;
-    void spawn_initial_buildings();
+    void plan_path(Car& car);
+    void set_tile(const Position& pos, TileType tile);
+    bool spawn_building(TileType type, CarColor color);
+    void add_building(const Position& pos, TileType type, CarColor color);
+    void restore_layout(const MapLayout& layout);
+    void clear_episode();
+    void reset_resources();
+    void grow_city();
     
     // Getters for RL training
     int get_score() const { return score; }
     int get_step() const { return current_step; }
     int get_car_count() const { return cars.size(); }
+    int get_stuck_cars() const { return stuck_cars; }
     bool should_close() const;
     
+    void set_config(const Config& scenario) { config = scenario; }
+    void set_reset_cache(std::shared_ptr<const ResetCache> cache) { reset_cache = std::move(cache); }
+    // Charge each phase of advance() and write_observation() to the profiler's counters (null to stop)
+    void set_profiler(PhaseProfiler* phase_profiler) { profiler = phase_profiler; }
+    // Record how long each step, reset, find_path() and observation takes (null to stop).
+    // The stats must only be written by the thread stepping this env.
+    void set_latency_stats(LatencyStats* stats) { latency_stats = stats; }
+    // Count steps, finished episodes, their scores and stuck cars into shared
+    // metrics (null to stop); each update is one relaxed atomic add
+    void set_metrics(EnvMetrics* env_metrics);
+    
+    // Start from map `index` of the bank, laid out in place; the same as
+    // reset(seed) with the seed the map was generated from
+    void set_map_bank(std::shared_ptr<const MapBank> bank) { map_bank = std::move(bank); }
+    int get_map_count() const { return map_bank ? map_bank->size() : 0; }
+    std::vector<float> reset_to_map(int index);
+    const Config& get_config() const { return config; }
+    
+    void set_traffic_model(TrafficModel model) { config.traffic_model = model; }
+    TrafficModel get_traffic_model() const { return config.traffic_model; }
+    
+    // Gridlock can only form under the Nagel-Schreckenberg model, where tiles hold one car
+    void set_terminate_on_gridlock(bool terminate) { config.terminate_on_gridlock = terminate; }
+    bool is_gridlocked() const { return gridlock_detector.gridlocked(); }
+    TerminationReason get_termination_reason() const { return termination_reason; }
+    
+    // Congestion per tile (see TrafficCounters::congestion) appended to the observation
+    void set_congestion_channel(bool enabled) { congestion_channel = enabled; }
+    void set_heatmap_overlay(bool enabled);
+    const TrafficCounters& get_traffic_counters() const { return traffic_counters; }
+    bool write_traffic_stats(const std::string& filepath) const;
+    
     // Getters for renderer access
-    const std::vector<std::vector<TileType>>& get_grid() const { return grid; }
+    const TileGrid& get_grid() const { return grid; }
     const std::vector<Building>& get_buildings() const { return buildings; }
     const std::vector<std::shared_ptr<Car>>& get_cars() const { return cars; }
     const std::unordered_map<std::string, int>& get_resources() const { return resources; }
@@ -171,6 +680,8 @@ private:
     // Color definitions
     std::unordered_map<TileType, glm::vec3> tile_colors;
     std::unordered_map<CarColor, glm::vec3> car_colors;
+    
+    bool heatmap_overlay;
 
 public:
     Renderer();
@@ -178,11 +689,14 @@ public:
     
     bool initialize();
     void render_frame(const MiniMotorwaysEnvironment& env);
-    void render_grid(const std::vector<std::vector<TileType>>& grid);
+    void render_grid(const TileGrid& grid);
+    void render_heatmap(const TileGrid& grid, const TrafficCounters& counters);
     void render_buildings(const std::vector<Building>& buildings);
     void render_cars(const std::vector<std::shared_ptr<Car>>& cars);
     void render_ui(int score, int step, const std::unordered_map<std::string, int>& resources);
     
+    void set_heatmap_overlay(bool enabled) { heatmap_overlay = enabled; }
+    
 private:
     GLuint load_shader(const std::string& vertex_src, const std::string& fragment_src);
     void setup_quad();
@@ -204,7 +718,7 @@ private:
 
 public:
     std::vector<Position> find_path(const Position& start, const Position& goal,
-                                  const std::vector<std::vector<TileType>>& grid) const;
+                                  const TileGrid& grid) const;
 };
 
 #endif // MINI_MOTORWAYS_ENV_H
\ No newline at end of file
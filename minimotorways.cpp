@@ -0,0 +1,106 @@
+#include "minimotorways.h"
+#include "vector_env.h"
+#include <exception>
+
+struct mm_vec {
+    std::unique_ptr<VectorEnv> envs;
+    mm_buffers buffers;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+int fail(const std::string& message) {
+    last_error = message;
+    return -1;
+}
+
+}  // namespace
+
+// C API Implementation. No exception may cross into the caller.
+int mm_api_version(void) {
+    return MM_API_VERSION;
+}
+
+const char* mm_last_error(void) {
+    return last_error.c_str();
+}
+
+mm_vec* mm_vec_create(int32_t num_envs, uint32_t seed, const char* scenario_path,
+                      const char* map_bank_path) {
+    if (num_envs <= 0) {
+        fail("num_envs must be positive");
+        return nullptr;
+    }
+    
+    try {
+        Config config;
+        if (scenario_path && !load_config(scenario_path, config)) {
+            fail(std::string("Failed to load scenario: ") + scenario_path);
+            return nullptr;
+        }
+        std::shared_ptr<MapBank> map_bank;
+        if (map_bank_path) {
+            map_bank = std::make_shared<MapBank>();
+            if (!map_bank->open(map_bank_path, config)) {
+                fail(std::string("Failed to open map bank: ") + map_bank_path);
+                return nullptr;
+            }
+        }
+        
+        std::unique_ptr<mm_vec> vec(new mm_vec());
+        vec->envs.reset(new VectorEnv(num_envs, config, seed));
+        vec->envs->set_map_bank(map_bank);
+        vec->envs->enable_action_masks();
+        
+        VectorEnv& envs = *vec->envs;
+        const TileGrid& grid = envs.env(0).get_grid();
+        mm_buffers& buffers = vec->buffers;
+        buffers.actions = envs.get_buffers().actions;
+        buffers.observations = envs.get_buffers().observations;
+        buffers.rewards = envs.get_buffers().rewards;
+        buffers.dones = envs.get_buffers().dones;
+        buffers.masks = envs.get_buffers().masks;
+        buffers.num_envs = num_envs;
+        buffers.observation_size = envs.observation_size();
+        buffers.action_size = VectorEnv::ACTION_SIZE;
+        buffers.num_action_types = MiniMotorwaysEnvironment::NUM_ACTION_TYPES;
+        buffers.grid_width = grid.width();
+        buffers.grid_height = grid.height();
+        return vec.release();
+    } catch (const std::exception& e) {
+        fail(e.what());
+        return nullptr;
+    }
+}
+
+void mm_vec_destroy(mm_vec* vec) {
+    delete vec;
+}
+
+int mm_vec_reset(mm_vec* vec) {
+    if (!vec) return fail("null vector");
+    try {
+        vec->envs->reset();
+        return 0;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+}
+
+int mm_vec_step(mm_vec* vec) {
+    if (!vec) return fail("null vector");
+    try {
+        vec->envs->step();
+        return 0;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+}
+
+int mm_get_buffers(const mm_vec* vec, mm_buffers* out) {
+    if (!vec || !out) return fail("null argument");
+    *out = vec->buffers;
+    return 0;
+}
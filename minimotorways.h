@@ -0,0 +1,67 @@
+#ifndef MINIMOTORWAYS_H
+#define MINIMOTORWAYS_H
+
+/*
+ * C interface of libminimotorways, for ctypes / cffi and other FFI users.
+ *
+ * A vector holds a batch of headless environments. Its buffers are allocated
+ * once by mm_vec_create and keep their addresses until mm_vec_destroy, so a
+ * caller can wrap them once (e.g. numpy.ctypeslib.as_array) and then drive the
+ * batch with one call per step: write actions, mm_vec_step, read results.
+ *
+ * Functions returning int give 0 on success and -1 on failure;
+ * mm_last_error() describes the most recent failure on the calling thread.
+ * Calls on the same vector must not overlap.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define MM_API __declspec(dllexport)
+#else
+#define MM_API __attribute__((visibility("default")))
+#endif
+
+/* Bumped whenever a signature or mm_buffers changes */
+#define MM_API_VERSION 1
+
+typedef struct mm_vec mm_vec;
+
+typedef struct mm_buffers {
+    int32_t* actions;        /* [num_envs][action_size]: action_type, x, y */
+    float* observations;     /* [num_envs][observation_size] */
+    float* rewards;          /* [num_envs] */
+    uint8_t* dones;          /* [num_envs]; a done env already holds its next episode */
+    uint8_t* masks;          /* [num_envs][num_action_types][grid_height][grid_width] */
+    int32_t num_envs;
+    int32_t observation_size;
+    int32_t action_size;
+    int32_t num_action_types;
+    int32_t grid_width;
+    int32_t grid_height;
+} mm_buffers;
+
+MM_API int mm_api_version(void);
+MM_API const char* mm_last_error(void);
+
+/* scenario_path and map_bank_path may be NULL for the defaults. Env i's k-th
+ * episode uses seed seed + i + k * num_envs (or that map of the bank). */
+MM_API mm_vec* mm_vec_create(int32_t num_envs, uint32_t seed, const char* scenario_path,
+                             const char* map_bank_path);
+MM_API void mm_vec_destroy(mm_vec* vec);
+
+MM_API int mm_vec_reset(mm_vec* vec);
+/* Steps every env with the actions buffer */
+MM_API int mm_vec_step(mm_vec* vec);
+
+MM_API int mm_get_buffers(const mm_vec* vec, mm_buffers* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MINIMOTORWAYS_H */
@@ -0,0 +1,255 @@
+#include "phase_profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+// In PhaseProfiler::Event order. Task clock is a software event, so the group
+// has a leader even where the hardware counters are not exposed (e.g. most VMs).
+const EventSpec EVENT_SPECS[PhaseProfiler::NUM_EVENTS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int open_event(const EventSpec& spec, int group_fd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = group_fd < 0 ? 1 : 0;  // The leader starts the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+#endif
+
+}  // namespace
+
+// PhaseProfiler Implementation
+PhaseProfiler::PhaseProfiler() : group_fd(-1), num_open(0) {
+    std::fill(read_cost, read_cost + NUM_EVENTS, 0);
+    std::fill(event_fds, event_fds + NUM_EVENTS, -1);
+    std::fill(event_slots, event_slots + NUM_EVENTS, -1);
+    clear();
+}
+
+PhaseProfiler::~PhaseProfiler() {
+    close();
+}
+
+bool PhaseProfiler::open() {
+#ifdef __linux__
+    close();
+    for (int event = 0; event < NUM_EVENTS; event++) {
+        int fd = open_event(EVENT_SPECS[event], group_fd);
+        if (fd < 0) continue;
+        if (group_fd < 0) group_fd = fd;
+        event_fds[event] = fd;
+        event_slots[event] = num_open++;
+    }
+    if (group_fd < 0) {
+        std::cerr << "perf_event_open failed: " << std::strerror(errno)
+                  << " (see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        return false;
+    }
+    ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    
+    // Calibrate: the smallest difference between back-to-back reads is what a
+    // read adds to every measured phase (mostly task clock, which counts the kernel)
+    std::fill(read_cost, read_cost + NUM_EVENTS, 0);
+    uint64_t cost[NUM_EVENTS];
+    std::fill(cost, cost + NUM_EVENTS, UINT64_MAX);
+    for (int i = 0; i < 64; i++) {
+        clear();
+        enter(StepPhase::ACTION);
+        leave();
+        for (int event = 0; event < NUM_EVENTS; event++) {
+            cost[event] = std::min(cost[event], totals[static_cast<int>(StepPhase::ACTION)][event]);
+        }
+    }
+    std::copy(cost, cost + NUM_EVENTS, read_cost);
+    clear();
+    return true;
+#else
+    std::cerr << "Hardware counter profiling needs Linux perf events" << std::endl;
+    return false;
+#endif
+}
+
+void PhaseProfiler::close() {
+#ifdef __linux__
+    for (int event = 0; event < NUM_EVENTS; event++) {
+        if (event_fds[event] >= 0) ::close(event_fds[event]);
+    }
+#endif
+    std::fill(event_fds, event_fds + NUM_EVENTS, -1);
+    std::fill(event_slots, event_slots + NUM_EVENTS, -1);
+    group_fd = -1;
+    num_open = 0;
+}
+
+void PhaseProfiler::clear() {
+    std::fill(last, last + NUM_EVENTS, 0);
+    std::fill(&totals[0][0], &totals[0][0] + NUM_PHASES * NUM_EVENTS, 0);
+    std::fill(calls, calls + NUM_PHASES, 0);
+    depth = 0;
+    steps = 0;
+}
+
+void PhaseProfiler::sample() {
+#ifdef __linux__
+    if (group_fd < 0) return;
+    
+    // PERF_FORMAT_GROUP: the number of events, then one value per event in open order
+    uint64_t values[1 + NUM_EVENTS];
+    if (read(group_fd, values, sizeof(uint64_t) * (1 + num_open)) <= 0) return;
+    
+    uint64_t now[NUM_EVENTS] = {};
+    for (int event = 0; event < NUM_EVENTS; event++) {
+        if (event_slots[event] >= 0) now[event] = values[1 + event_slots[event]];
+    }
+    if (depth > 0) {
+        uint64_t* phase_totals = totals[stack[depth - 1]];
+        for (int event = 0; event < NUM_EVENTS; event++) {
+            uint64_t delta = now[event] - last[event];
+            phase_totals[event] += delta > read_cost[event] ? delta - read_cost[event] : 0;
+        }
+    }
+    std::copy(now, now + NUM_EVENTS, last);
+#endif
+}
+
+void PhaseProfiler::enter(StepPhase phase) {
+    sample();
+    if (depth < MAX_DEPTH) {
+        stack[depth++] = static_cast<int>(phase);
+        calls[static_cast<int>(phase)]++;
+    }
+}
+
+void PhaseProfiler::leave() {
+    sample();
+    if (depth > 0) depth--;
+}
+
+const char* PhaseProfiler::phase_name(StepPhase phase) {
+    switch (phase) {
+        case StepPhase::ACTION: return "action";
+        case StepPhase::PATHFINDING: return "pathfinding";
+        case StepPhase::TRAFFIC: return "traffic";
+        case StepPhase::SPAWNING: return "spawning";
+        case StepPhase::GROWTH: return "growth";
+        case StepPhase::GAME_OVER: return "game_over";
+        case StepPhase::OBSERVATION: return "observation";
+        default: return "unknown";
+    }
+}
+
+const char* PhaseProfiler::event_name(Event event) {
+    switch (event) {
+        case TASK_CLOCK: return "task_clock_ns";
+        case CYCLES: return "cycles";
+        case INSTRUCTIONS: return "instructions";
+        case L1D_MISSES: return "l1d_read_misses";
+        case LLC_MISSES: return "llc_misses";
+        case BRANCH_MISSES: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+void PhaseProfiler::print(std::ostream& out) const {
+    const Event columns[] = {TASK_CLOCK, CYCLES, L1D_MISSES, LLC_MISSES, BRANCH_MISSES};
+    double per_step = steps > 0 ? 1.0 / steps : 0.0;
+    
+    out << "Per-step counters over " << steps << " steps";
+    if (has_event(TASK_CLOCK)) {
+        out << " (" << read_cost[TASK_CLOCK] << " ns per counter read taken off)";
+    }
+    out << ":" << std::endl;
+    out << std::left << std::setw(13) << "phase" << std::right << std::setw(10) << "calls";
+    for (Event event : columns) {
+        out << std::setw(17) << event_name(event);
+    }
+    out << std::setw(8) << "IPC" << std::endl;
+    
+    out << std::fixed << std::setprecision(2);
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        if (calls[phase] == 0) continue;
+        out << std::left << std::setw(13) << phase_name(static_cast<StepPhase>(phase)) << std::right
+            << std::setw(10) << calls[phase] * per_step;
+        for (Event event : columns) {
+            if (has_event(event)) {
+                out << std::setw(17) << totals[phase][event] * per_step;
+            } else {
+                out << std::setw(17) << "n/a";
+            }
+        }
+        if (has_event(CYCLES) && has_event(INSTRUCTIONS) && totals[phase][CYCLES] > 0) {
+            out << std::setw(8) << static_cast<double>(totals[phase][INSTRUCTIONS]) / totals[phase][CYCLES];
+        } else {
+            out << std::setw(8) << "n/a";
+        }
+        out << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+bool PhaseProfiler::write_json(const std::string& filepath) const {
+    std::ofstream out(filepath);
+    if (!out) {
+        std::cerr << "Failed to open profile file: " << filepath << std::endl;
+        return false;
+    }
+    
+    double per_step = steps > 0 ? 1.0 / steps : 0.0;
+    out << "{\n  \"steps\": " << steps << ",\n  \"events\": [";
+    bool first = true;
+    for (int event = 0; event < NUM_EVENTS; event++) {
+        if (!has_event(static_cast<Event>(event))) continue;
+        out << (first ? "" : ", ") << "\"" << event_name(static_cast<Event>(event)) << "\"";
+        first = false;
+    }
+    out << "],\n  \"phases\": {";
+    
+    first = true;
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        if (calls[phase] == 0) continue;
+        out << (first ? "\n" : ",\n") << "    \"" << phase_name(static_cast<StepPhase>(phase)) << "\": {"
+            << "\"calls_per_step\": " << calls[phase] * per_step;
+        for (int event = 0; event < NUM_EVENTS; event++) {
+            if (!has_event(static_cast<Event>(event))) continue;
+            out << ", \"" << event_name(static_cast<Event>(event)) << "_per_step\": " << totals[phase][event] * per_step;
+        }
+        if (has_event(CYCLES) && has_event(INSTRUCTIONS) && totals[phase][CYCLES] > 0) {
+            out << ", \"ipc\": " << static_cast<double>(totals[phase][INSTRUCTIONS]) / totals[phase][CYCLES];
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+    return true;
+}
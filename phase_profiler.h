@@ -0,0 +1,90 @@
+#ifndef PHASE_PROFILER_H
+#define PHASE_PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Parts of an environment step measured by PhaseProfiler
+enum class StepPhase {
+    ACTION,
+    PATHFINDING,  // find_path() calls, not counted in TRAFFIC
+    TRAFFIC,
+    SPAWNING,
+    GROWTH,
+    GAME_OVER,
+    OBSERVATION,
+    COUNT
+};
+
+// Hardware counters per step phase, read with perf_event_open (Linux only).
+// Counters are read on every phase change and the difference is charged to the
+// innermost open phase, so a nested phase is not counted in its parent. Each
+// read is a system call of about a microsecond, so this is for profiling
+// runs, not training. Events the CPU or kernel does not offer are reported as missing.
+class PhaseProfiler {
+public:
+    enum Event { TASK_CLOCK, CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, NUM_EVENTS };
+    static const int NUM_PHASES = static_cast<int>(StepPhase::COUNT);
+    static const int MAX_DEPTH = 8;
+
+private:
+    int group_fd;
+    int event_fds[NUM_EVENTS];
+    int event_slots[NUM_EVENTS];  // Position in a group read, -1 when not opened
+    int num_open;
+    
+    uint64_t last[NUM_EVENTS];
+    uint64_t read_cost[NUM_EVENTS];  // Counted by one read itself, taken off every delta
+    uint64_t totals[NUM_PHASES][NUM_EVENTS];
+    uint64_t calls[NUM_PHASES];
+    int stack[MAX_DEPTH];
+    int depth;
+    int64_t steps;
+    
+    void sample();
+
+public:
+    PhaseProfiler();
+    ~PhaseProfiler();
+    
+    PhaseProfiler(const PhaseProfiler&) = delete;
+    PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+    
+    // Start counting for the calling thread; false when perf is unavailable
+    bool open();
+    void close();
+    bool is_open() const { return group_fd >= 0; }
+    bool has_event(Event event) const { return event_slots[event] >= 0; }
+    
+    void enter(StepPhase phase);
+    void leave();
+    void end_step() { steps++; }
+    void clear();
+    
+    // Per-phase IPC and events per step
+    void print(std::ostream& out) const;
+    bool write_json(const std::string& filepath) const;
+    
+    static const char* phase_name(StepPhase phase);
+    static const char* event_name(Event event);
+};
+
+// Measures one phase for the lifetime of the scope; a null profiler costs one branch
+class PhaseScope {
+private:
+    PhaseProfiler* profiler;
+
+public:
+    PhaseScope(PhaseProfiler* profiler, StepPhase phase) : profiler(profiler) {
+        if (profiler) profiler->enter(phase);
+    }
+    ~PhaseScope() {
+        if (profiler) profiler->leave();
+    }
+    
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+};
+
+#endif // PHASE_PROFILER_H
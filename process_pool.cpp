@@ -0,0 +1,160 @@
+#include "process_pool.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string current_executable(const char* argv0) {
+#if defined(__linux__)
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length > 0) {
+        return std::string(path, length);
+    }
+#elif defined(__APPLE__)
+    char path[4096];
+    uint32_t size = sizeof(path);
+    if (_NSGetExecutablePath(path, &size) == 0) {
+        return path;
+    }
+#endif
+    return argv0;
+}
+
+bool send_worker_report(int report_fd, const WorkerReport& report) {
+    // Reports are far below PIPE_BUF, so the write is atomic
+    ssize_t written;
+    do {
+        written = write(report_fd, &report, sizeof(report));
+    } while (written < 0 && errno == EINTR);
+    return written == static_cast<ssize_t>(sizeof(report));
+}
+
+// ProcessPool Implementation
+ProcessPool::~ProcessPool() {
+    std::vector<WorkerReport> reports;
+    std::vector<double> startup_seconds;
+    wait(reports, startup_seconds);
+}
+
+bool ProcessPool::fork_worker(const std::function<WorkerReport(int index)>& body) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        std::cerr << "pipe failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Buffered output would otherwise be written once by each process
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    
+    int index = static_cast<int>(workers.size());
+    int64_t launched = steady_now_ns();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+    
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        for (const Worker& worker : workers) {
+            close(worker.report_fd);
+        }
+        bool reported = send_worker_report(pipe_fds[1], body(index));
+        std::cout.flush();
+        // Skip the parent's atexit handlers and static destructors
+        _exit(reported ? 0 : 1);
+    }
+    
+    close(pipe_fds[1]);
+    workers.push_back({pid, pipe_fds[0], launched});
+    return true;
+}
+
+bool ProcessPool::spawn_worker(const std::vector<std::string>& argv) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        std::cerr << "pipe failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Only the write end reaches the new program
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    
+    // Everything exec needs is prepared before forking
+    std::vector<std::string> args = argv;
+    args.push_back("--report-fd");
+    args.push_back(std::to_string(pipe_fds[1]));
+    std::vector<char*> exec_args;
+    for (std::string& arg : args) {
+        exec_args.push_back(&arg[0]);
+    }
+    exec_args.push_back(nullptr);
+    
+    std::cout.flush();
+    std::cerr.flush();
+    
+    int64_t launched = steady_now_ns();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+    
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        execv(exec_args[0], exec_args.data());
+        _exit(127);
+    }
+    
+    close(pipe_fds[1]);
+    workers.push_back({pid, pipe_fds[0], launched});
+    return true;
+}
+
+bool ProcessPool::wait(std::vector<WorkerReport>& reports, std::vector<double>& startup_seconds) {
+    reports.clear();
+    startup_seconds.clear();
+    bool all_reported = true;
+    
+    for (const Worker& worker : workers) {
+        WorkerReport report;
+        ssize_t got;
+        do {
+            got = read(worker.report_fd, &report, sizeof(report));
+        } while (got < 0 && errno == EINTR);
+        close(worker.report_fd);
+        
+        int status = 0;
+        waitpid(worker.pid, &status, 0);
+        
+        if (got != static_cast<ssize_t>(sizeof(report)) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Worker process " << worker.pid << " failed" << std::endl;
+            all_reported = false;
+            continue;
+        }
+        reports.push_back(report);
+        startup_seconds.push_back((report.ready_ns - worker.launched_ns) * 1e-9);
+    }
+    
+    workers.clear();
+    return all_reported;
+}
@@ -0,0 +1,58 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// What a worker process sends back to the pool when it finishes
+struct WorkerReport {
+    int64_t ready_ns;      // steady_now_ns() once the worker could take its first step
+    int64_t env_steps;
+    int64_t episodes;
+    double total_reward;
+    double run_seconds;    // Time spent stepping after ready
+};
+
+// steady_clock in nanoseconds; on Linux and macOS this clock is shared by
+// every process, so timestamps from workers compare with the parent's
+int64_t steady_now_ns();
+
+// Hand a report to the pool through the descriptor a worker was given
+bool send_worker_report(int report_fd, const WorkerReport& report);
+
+// Absolute path of the running program, for exec'ing more copies of it.
+// argv0 is the fallback where the OS cannot say; it only works with a slash in it.
+std::string current_executable(const char* argv0);
+
+// Worker processes started either by fork(), sharing everything the parent
+// has loaded copy-on-write, or cold through exec(), loading it all again.
+// The parent must have no other threads running when it forks.
+class ProcessPool {
+private:
+    struct Worker {
+        pid_t pid;
+        int report_fd;
+        int64_t launched_ns;
+    };
+    
+    std::vector<Worker> workers;
+
+public:
+    ~ProcessPool();
+    
+    // Run body(index) in a forked child, which exits after reporting its result
+    bool fork_worker(const std::function<WorkerReport(int index)>& body);
+    // Exec argv with "--report-fd <fd>" appended; the program reports with send_worker_report()
+    bool spawn_worker(const std::vector<std::string>& argv);
+    
+    // Wait for every worker. Reports and startup times (launch to ready) are in
+    // launch order; false if any worker failed to report.
+    bool wait(std::vector<WorkerReport>& reports, std::vector<double>& startup_seconds);
+    
+    int size() const { return static_cast<int>(workers.size()); }
+};
+
+#endif // PROCESS_POOL_H
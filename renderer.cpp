@@ -32,7 +32,7 @@ void main()
 }
 )";
 
-Renderer::Renderer() : shader_program(0), vao(0), vbo(0) {
+Renderer::Renderer() : shader_program(0), vao(0), vbo(0), heatmap_overlay(false) {
     // Initialize color mappings
     tile_colors[TileType::EMPTY] = glm::vec3(0.1f, 0.1f, 0.1f);       // Dark gray
     tile_colors[TileType::HOUSE] = glm::vec3(0.8f, 0.2f, 0.2f);       // Red
@@ -84,6 +84,11 @@ void Renderer::render_frame(const MiniMotorwaysEnvironment& env) {
     // Render grid background
     render_grid(env.get_grid());
     
+    // Render congestion heatmap
+    if (heatmap_overlay) {
+        render_heatmap(env.get_grid(), env.get_traffic_counters());
+    }
+    
     // Render buildings
     render_buildings(env.get_buildings());
     
@@ -94,27 +99,69 @@ void Renderer::render_frame(const MiniMotorwaysEnvironment& env) {
     render_ui(env.get_score(), env.get_step(), env.get_resources());
 }
 
-void Renderer::render_grid(const std::vector<std::vector<TileType>>& grid) {
+void Renderer::render_grid(const TileGrid& grid) {
+    glBindVertexArray(vao);
+    
+    // EMPTY tiles match the clear colour, so only allocated chunks are visited and
+    // each packed word is scanned for its non-empty nibbles.
+    for (int cy = 0; cy < grid.chunks_y(); cy++) {
+        for (int cx = 0; cx < grid.chunks_x(); cx++) {
+            const uint64_t* words = grid.chunk_words(cx, cy);
+            if (!words) continue;
+            
+            for (int i = 0; i < TileGrid::CHUNK_WORDS; i++) {
+                uint64_t occupied = TileGrid::passable_nibbles(words[i]);
+                while (occupied) {
+                    int x = cx * TileGrid::CHUNK_SIZE +
+                            (i % TileGrid::CHUNK_ROW_WORDS) * TileGrid::TILES_PER_WORD +
+                            __builtin_ctzll(occupied) / TileGrid::BITS_PER_TILE;
+                    int y = cy * TileGrid::CHUNK_SIZE + i / TileGrid::CHUNK_ROW_WORDS;
+                    occupied &= occupied - 1;
+                    
+                    TileType tile = grid.get(x, y);
+                    glm::vec3 color = tile_colors[tile];
+                    
+                    // Create model matrix for this tile
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, glm::vec3(x, y, 0.0f));
+                    model = glm::scale(model, glm::vec3(0.9f, 0.9f, 1.0f));  // Small gap between tiles
+                    
+                    // Set uniforms
+                    GLint model_loc = glGetUniformLocation(shader_program, "model");
+                    GLint color_loc = glGetUniformLocation(shader_program, "color");
+                    
+                    glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model));
+                    glUniform3fv(color_loc, 1, glm::value_ptr(color));
+                    
+                    // Draw quad
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                }
+            }
+        }
+    }
+}
+
+void Renderer::render_heatmap(const TileGrid& grid, const TrafficCounters& counters) {
     glBindVertexArray(vao);
     
-    for (int y = 0; y < grid.size(); y++) {
-        for (int x = 0; x < grid[y].size(); x++) {
-            TileType tile = grid[y][x];
-            glm::vec3 color = tile_colors[tile];
+    for (int y = 0; y < grid.height(); y++) {
+        for (int x = 0; x < grid.width(); x++) {
+            float heat = counters.congestion(y * grid.width() + x);
+            if (heat < 0.05f) continue;
+            
+            // Yellow when traffic mostly flows, red when it mostly waits
+            glm::vec3 color = glm::vec3(1.0f, 1.0f - heat, 0.0f);
             
-            // Create model matrix for this tile
             glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(x, y, 0.0f));
-            model = glm::scale(model, glm::vec3(0.9f, 0.9f, 1.0f));  // Small gap between tiles
+            model = glm::translate(model, glm::vec3(x + 0.25f, y + 0.25f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.4f, 0.4f, 1.0f));
             
-            // Set uniforms
             GLint model_loc = glGetUniformLocation(shader_program, "model");
             GLint color_loc = glGetUniformLocation(shader_program, "color");
             
             glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model));
             glUniform3fv(color_loc, 1, glm::value_ptr(color));
             
-            // Draw quad
             glDrawArrays(GL_TRIANGLES, 0, 6);
         }
     }
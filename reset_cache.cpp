@@ -0,0 +1,87 @@
+#include "mini_motorways_env.h"
+
+namespace {
+
+// Seed of an episode's RNG stream, decorrelated from the map layout stream
+// (seeded with `seed` itself) by a 32-bit integer hash
+uint32_t episode_stream_seed(uint32_t seed) {
+    seed += 0x9E3779B9u;
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+    return seed;
+}
+
+}  // namespace
+
+// ResetCache Implementation
+ResetCache::ResetCache(const Config& config, int grid_width, int grid_height,
+                       unsigned first_seed, int count)
+    : first_seed(first_seed), layouts(count), generated(0), stopping(false) {
+    worker = std::thread([this, config, grid_width, grid_height]() {
+        for (int i = 0; i < static_cast<int>(layouts.size()); i++) {
+            if (stopping.load(std::memory_order_relaxed)) break;
+            
+            generate_layout(this->first_seed + i, config, grid_width, grid_height, layouts[i]);
+            generated.store(i + 1, std::memory_order_release);
+        }
+    });
+}
+
+ResetCache::~ResetCache() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ResetCache::wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+const MapLayout* ResetCache::find(unsigned seed) const {
+    unsigned index = seed - first_seed;  // Wraps to a large value below first_seed
+    if (index >= static_cast<unsigned>(generated.load(std::memory_order_acquire))) {
+        return nullptr;
+    }
+    return &layouts[index];
+}
+
+void ResetCache::seed_episode_rng(unsigned seed, std::mt19937& episode_rng) {
+    // Discarding one draw runs the twist here instead of in the episode
+    episode_rng.seed(episode_stream_seed(seed));
+    episode_rng.discard(1);
+}
+
+void ResetCache::generate_layout(unsigned seed, const Config& config, int grid_width,
+                                 int grid_height, MapLayout& layout) {
+    std::mt19937 layout_rng(seed);
+    FreeTileSet free_tiles;
+    free_tiles.reset(grid_width, grid_height);
+    
+    layout = MapLayout{};
+    layout.seed = seed;
+    layout.active_colors = static_cast<uint8_t>(config.initial_colors);
+    
+    // Houses, then businesses; building i of each kind takes colour i % initial_colors
+    auto place = [&](TileType type, int count) {
+        for (int i = 0; i < count; i++) {
+            if (layout.building_count == MapLayout::MAX_BUILDINGS || free_tiles.size() == 0) return;
+            
+            Position pos = free_tiles.sample(layout_rng);
+            free_tiles.erase(pos);
+            
+            MapLayout::PackedBuilding& building = layout.buildings[layout.building_count++];
+            building.x = static_cast<uint8_t>(pos.x);
+            building.y = static_cast<uint8_t>(pos.y);
+            building.type = static_cast<uint8_t>(type);
+            building.color = static_cast<uint8_t>(i % config.initial_colors);
+        }
+    };
+    place(TileType::HOUSE, config.initial_houses);
+    place(TileType::BUSINESS, config.initial_businesses);
+}
@@ -0,0 +1,504 @@
+#include "rollout.h"
+#include "trace.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char UNIX_PREFIX[] = "unix:";
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;  // A vanished peer is an error, not SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+bool is_unix_address(const std::string& address) {
+    return address.compare(0, sizeof(UNIX_PREFIX) - 1, UNIX_PREFIX) == 0;
+}
+
+bool unix_socket_address(const std::string& address, sockaddr_un& out) {
+    std::string path = address.substr(sizeof(UNIX_PREFIX) - 1);
+    if (path.empty() || path.size() >= sizeof(out.sun_path)) {
+        std::cerr << "Bad unix socket path: " << address << std::endl;
+        return false;
+    }
+    std::memset(&out, 0, sizeof(out));
+    out.sun_family = AF_UNIX;
+    std::memcpy(out.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// "host:port" (an empty host listens on every interface)
+addrinfo* resolve_tcp_address(const std::string& address, bool passive) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "Addresses are unix:<path> or <host>:<port>, not " << address << std::endl;
+        return nullptr;
+    }
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    
+    addrinfo* result = nullptr;
+    int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (error != 0) {
+        std::cerr << "Cannot resolve " << address << ": " << gai_strerror(error) << std::endl;
+        return nullptr;
+    }
+    return result;
+}
+
+void configure_socket(int fd, bool tcp) {
+    int on = 1;
+    if (tcp) {
+        // Replies are small and latency-bound
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+}  // namespace
+
+// Compact observation encoding
+int compact_observation_size(int observation_size, int tiles) {
+    return 2 * tiles + static_cast<int>(sizeof(float)) * (observation_size - 2 * tiles);
+}
+
+void compact_observation(const float* observation, int observation_size, int tiles, uint8_t* out) {
+    // Tile types are stored in sevenths, densities in fifths, as the environment scales them
+    for (int i = 0; i < tiles; i++) {
+        out[i] = static_cast<uint8_t>(observation[i] * 7.0f + 0.5f);
+        out[tiles + i] = static_cast<uint8_t>(observation[tiles + i] * 5.0f + 0.5f);
+    }
+    std::memcpy(out + 2 * tiles, observation + 2 * tiles, sizeof(float) * (observation_size - 2 * tiles));
+}
+
+void expand_observation(const uint8_t* compact, int observation_size, int tiles, float* out) {
+    for (int i = 0; i < tiles; i++) {
+        // The same expressions the environment uses, so the floats match bit for bit
+        out[i] = compact[i] / 7.0f;
+        out[tiles + i] = compact[tiles + i] / 5.0f;
+    }
+    std::memcpy(out + 2 * tiles, compact + 2 * tiles, sizeof(float) * (observation_size - 2 * tiles));
+}
+
+// RolloutConnection Implementation
+RolloutConnection::~RolloutConnection() {
+    close();
+}
+
+bool RolloutConnection::connect(const std::string& address) {
+    close();
+    
+    if (is_unix_address(address)) {
+        sockaddr_un addr;
+        if (!unix_socket_address(address, addr)) return false;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            configure_socket(fd, false);
+            return true;
+        }
+    } else {
+        addrinfo* candidates = resolve_tcp_address(address, false);
+        for (addrinfo* ai = candidates; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            ::close(fd);
+            fd = -1;
+        }
+        if (candidates) {
+            freeaddrinfo(candidates);
+        }
+        if (fd >= 0) {
+            configure_socket(fd, true);
+            return true;
+        }
+    }
+    
+    std::cerr << "Failed to connect to " << address << ": " << std::strerror(errno) << std::endl;
+    close();
+    return false;
+}
+
+void RolloutConnection::close() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    read_start = 0;
+    read_end = 0;
+}
+
+bool RolloutConnection::send(RolloutMessage type, uint32_t request_id, uint32_t first_env,
+                             uint32_t env_count, const void* payload, uint32_t payload_size) {
+    RolloutHeader header = {payload_size, static_cast<uint16_t>(type), RolloutHeader::VERSION,
+                            request_id, first_env, env_count};
+    
+    // Header and payload leave in one call; partial writes resume where they stopped
+    iovec parts[2] = {{&header, sizeof(header)}, {const_cast<void*>(payload), payload_size}};
+    iovec* part = parts;
+    int part_count = payload_size > 0 ? 2 : 1;
+    while (part_count > 0) {
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = part;
+        msg.msg_iovlen = part_count;
+        ssize_t written = sendmsg(fd, &msg, SEND_FLAGS);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (part_count > 0 && static_cast<size_t>(written) >= part->iov_len) {
+            written -= part->iov_len;
+            part++;
+            part_count--;
+        }
+        if (part_count > 0) {
+            part->iov_base = static_cast<char*>(part->iov_base) + written;
+            part->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+bool RolloutConnection::fill(size_t needed) {
+    if (read_end - read_start >= needed) return true;
+    
+    // Move the unread tail to the front, then grow to fit
+    if (read_start > 0) {
+        std::memmove(read_buffer.data(), read_buffer.data() + read_start, read_end - read_start);
+        read_end -= read_start;
+        read_start = 0;
+    }
+    if (read_buffer.size() < needed) {
+        read_buffer.resize(std::max(needed, 2 * read_buffer.size() + 4096));
+    }
+    
+    while (read_end < needed) {
+        ssize_t got = read(fd, read_buffer.data() + read_end, read_buffer.size() - read_end);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        read_end += got;
+    }
+    return true;
+}
+
+bool RolloutConnection::receive(RolloutHeader& header, std::vector<uint8_t>& payload) {
+    if (fd < 0 || !fill(sizeof(header))) return false;
+    std::memcpy(&header, read_buffer.data() + read_start, sizeof(header));
+    if (header.version != RolloutHeader::VERSION || header.payload_size > RolloutHeader::MAX_PAYLOAD) {
+        std::cerr << "Malformed rollout message (version " << header.version << ", "
+                  << header.payload_size << " bytes)" << std::endl;
+        return false;
+    }
+    
+    if (!fill(sizeof(header) + header.payload_size)) return false;
+    const uint8_t* body = read_buffer.data() + read_start + sizeof(header);
+    payload.assign(body, body + header.payload_size);
+    read_start += sizeof(header) + header.payload_size;
+    return true;
+}
+
+bool RolloutConnection::has_message() const {
+    size_t available = read_end - read_start;
+    if (available < sizeof(RolloutHeader)) return false;
+    RolloutHeader header;
+    std::memcpy(&header, read_buffer.data() + read_start, sizeof(header));
+    return available >= sizeof(header) + header.payload_size;
+}
+
+int listen_on(const std::string& address) {
+    int fd = -1;
+    if (is_unix_address(address)) {
+        sockaddr_un addr;
+        if (!unix_socket_address(address, addr)) return -1;
+        // A socket file left behind by a dead worker refuses connections and is
+        // removed; one that accepts belongs to a live worker and is left alone
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0) {
+            bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+            bool stale = !live && errno == ECONNREFUSED;
+            ::close(probe);
+            if (live) {
+                std::cerr << "Failed to listen on " << address << ": another process is listening there"
+                          << std::endl;
+                return -1;
+            }
+            if (stale) {
+                unlink(addr.sun_path);
+            }
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    } else {
+        addrinfo* candidates = resolve_tcp_address(address, true);
+        for (addrinfo* ai = candidates; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            ::close(fd);
+            fd = -1;
+        }
+        if (candidates) {
+            freeaddrinfo(candidates);
+        }
+    }
+    
+    if (fd < 0 || listen(fd, 16) != 0) {
+        std::cerr << "Failed to listen on " << address << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+bool run_rollout_worker(const std::string& address, VectorEnv& envs) {
+    int listen_fd = listen_on(address);
+    if (listen_fd < 0) return false;
+    
+    const TileGrid& grid = envs.env(0).get_grid();
+    const int obs_size = envs.observation_size();
+    const int tiles = grid.width() * grid.height();
+    const int compact_size = compact_observation_size(obs_size, tiles);
+    const uint32_t hello[3] = {static_cast<uint32_t>(envs.size()), static_cast<uint32_t>(obs_size),
+                               static_cast<uint32_t>(tiles)};
+    
+    RolloutHeader header;
+    std::vector<uint8_t> request;
+    std::vector<uint8_t> reply;
+    bool shutdown = false;
+    
+    while (!shutdown) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        configure_socket(fd, !is_unix_address(address));
+        RolloutConnection connection(fd);
+        if (!connection.send(RolloutMessage::HELLO, 0, 0, 0, hello, sizeof(hello))) continue;
+        
+        while (connection.receive(header, request)) {
+            RolloutMessage type = static_cast<RolloutMessage>(header.type);
+            if (type == RolloutMessage::SHUTDOWN) {
+                shutdown = true;
+                break;
+            }
+            
+            int first = header.first_env;
+            int count = header.env_count;
+            if (header.first_env > static_cast<uint32_t>(envs.size()) ||
+                header.env_count > static_cast<uint32_t>(envs.size() - first)) {
+                std::cerr << "Request for envs outside [0, " << envs.size() << ")" << std::endl;
+                break;
+            }
+            
+            if (type == RolloutMessage::RESET) {
+                envs.reset(first, count);
+            } else if (type == RolloutMessage::STEP && request.size() == static_cast<size_t>(count) * 3) {
+                int32_t* actions = envs.actions() + first * VectorEnv::ACTION_SIZE;
+                for (int i = 0; i < count * 3; i++) {
+                    actions[i] = request[i];
+                }
+                envs.step(first, count);
+            } else {
+                std::cerr << "Unexpected rollout message of type " << header.type << std::endl;
+                break;
+            }
+            
+            // rewards, dones, then the compact observations of the slice
+            reply.resize(static_cast<size_t>(count) * (sizeof(float) + 1 + compact_size));
+            uint8_t* out = reply.data();
+            std::memcpy(out, envs.rewards() + first, sizeof(float) * count);
+            out += sizeof(float) * count;
+            std::memcpy(out, envs.dones() + first, count);
+            out += count;
+            for (int i = first; i < first + count; i++) {
+                compact_observation(envs.observations() + static_cast<size_t>(i) * obs_size,
+                                    obs_size, tiles, out);
+                out += compact_size;
+            }
+            
+            if (!connection.send(RolloutMessage::RESULT, header.request_id, first, count,
+                                 reply.data(), reply.size())) {
+                break;
+            }
+        }
+    }
+    
+    ::close(listen_fd);
+    if (is_unix_address(address)) {
+        unlink(address.c_str() + sizeof(UNIX_PREFIX) - 1);
+    }
+    return true;
+}
+
+// RolloutCoordinator Implementation
+bool RolloutCoordinator::connect(const std::vector<std::string>& addresses, int slices_per_worker) {
+    workers.clear();
+    slices.clear();
+    pending.clear();
+    total_envs = 0;
+    
+    RolloutHeader header;
+    for (const std::string& address : addresses) {
+        std::unique_ptr<RolloutConnection> connection(new RolloutConnection());
+        if (!connection->connect(address)) return false;
+        
+        if (!connection->receive(header, message) ||
+            static_cast<RolloutMessage>(header.type) != RolloutMessage::HELLO ||
+            message.size() != 3 * sizeof(uint32_t)) {
+            std::cerr << "No greeting from rollout worker at " << address << std::endl;
+            return false;
+        }
+        uint32_t hello[3];
+        std::memcpy(hello, message.data(), sizeof(hello));
+        int worker_envs = hello[0];
+        if (!workers.empty() && (static_cast<int>(hello[1]) != obs_size || static_cast<int>(hello[2]) != tiles)) {
+            std::cerr << "Worker at " << address << " uses a different observation layout" << std::endl;
+            return false;
+        }
+        obs_size = hello[1];
+        tiles = hello[2];
+        
+        // Near-equal slices of the worker's envs
+        int worker = static_cast<int>(workers.size());
+        int slice_count = std::max(1, std::min(slices_per_worker, worker_envs));
+        for (int s = 0; s < slice_count; s++) {
+            int begin = worker_envs * s / slice_count;
+            int end = worker_envs * (s + 1) / slice_count;
+            slices.push_back({worker, begin, total_envs + begin, end - begin});
+        }
+        total_envs += worker_envs;
+        workers.push_back(std::move(connection));
+    }
+    
+    pending.resize(workers.size());
+    observations.assign(static_cast<size_t>(total_envs) * obs_size, 0.0f);
+    rewards.assign(total_envs, 0.0f);
+    dones.assign(total_envs, 0);
+    return true;
+}
+
+bool RolloutCoordinator::send(int slice, RolloutMessage type, const void* payload, uint32_t payload_size) {
+    const Slice& target = slices[slice];
+    uint32_t request_id = next_request++;
+    if (!workers[target.worker]->send(type, request_id, target.first_env, target.count,
+                                      payload, payload_size)) {
+        std::cerr << "Lost rollout worker " << target.worker << std::endl;
+        return false;
+    }
+    pending[target.worker].emplace_back(request_id, slice);
+    return true;
+}
+
+bool RolloutCoordinator::reset(int slice) {
+    return send(slice, RolloutMessage::RESET, nullptr, 0);
+}
+
+bool RolloutCoordinator::step(int slice, const int32_t* slice_actions) {
+    int count = slices[slice].count;
+    actions.resize(static_cast<size_t>(count) * 3);
+    for (int i = 0; i < count * 3; i++) {
+        actions[i] = static_cast<uint8_t>(slice_actions[i]);
+    }
+    return send(slice, RolloutMessage::STEP, actions.data(), actions.size());
+}
+
+int RolloutCoordinator::receive() {
+    MM_TRACE_SCOPE("rollout_receive", "ipc");
+    // Results already buffered first, then wait on every worker that owes one
+    int ready = -1;
+    for (size_t w = 0; w < workers.size() && ready < 0; w++) {
+        if (!pending[w].empty() && workers[w]->has_message()) {
+            ready = w;
+        }
+    }
+    
+    std::vector<pollfd> waiting;
+    while (ready < 0) {
+        waiting.clear();
+        for (size_t w = 0; w < workers.size(); w++) {
+            if (!pending[w].empty()) {
+                waiting.push_back({workers[w]->get_fd(), POLLIN, 0});
+            }
+        }
+        if (waiting.empty()) {
+            std::cerr << "No rollout requests in flight" << std::endl;
+            return -1;
+        }
+        if (poll(waiting.data(), waiting.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (size_t w = 0, i = 0; w < workers.size() && ready < 0; w++) {
+            if (pending[w].empty()) continue;
+            if (waiting[i++].revents != 0) {
+                ready = w;
+            }
+        }
+    }
+    
+    RolloutHeader header;
+    if (!workers[ready]->receive(header, message)) {
+        std::cerr << "Lost rollout worker " << ready << std::endl;
+        return -1;
+    }
+    std::pair<uint32_t, int> expected = pending[ready].front();
+    pending[ready].pop_front();
+    
+    const Slice& slice = slices[expected.second];
+    const int compact_size = compact_observation_size(obs_size, tiles);
+    size_t expected_size = static_cast<size_t>(slice.count) * (sizeof(float) + 1 + compact_size);
+    if (static_cast<RolloutMessage>(header.type) != RolloutMessage::RESULT ||
+        header.request_id != expected.first || message.size() != expected_size) {
+        std::cerr << "Out-of-order reply from rollout worker " << ready << std::endl;
+        return -1;
+    }
+    
+    const uint8_t* in = message.data();
+    std::memcpy(&rewards[slice.global_first], in, sizeof(float) * slice.count);
+    in += sizeof(float) * slice.count;
+    std::memcpy(&dones[slice.global_first], in, slice.count);
+    in += slice.count;
+    for (int i = 0; i < slice.count; i++) {
+        expand_observation(in, obs_size, tiles,
+                           &observations[static_cast<size_t>(slice.global_first + i) * obs_size]);
+        in += compact_size;
+    }
+    return expected.second;
+}
+
+void RolloutCoordinator::shutdown() {
+    for (auto& worker : workers) {
+        worker->send(RolloutMessage::SHUTDOWN, next_request++, 0, 0, nullptr, 0);
+        worker->close();
+    }
+    workers.clear();
+}
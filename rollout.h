@@ -0,0 +1,137 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "vector_env.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Rollout workers host a VectorEnv and are driven by a coordinator over a
+// stream socket: "unix:/path" for processes on one box, "host:port" for TCP.
+//
+// Every message is a RolloutHeader followed by payload_size bytes. Requests
+// name a slice of the worker's envs, so a coordinator can keep several slices
+// in flight on one connection; the worker answers each in order with a RESULT
+// carrying the same request_id. Fields travel in host byte order, so both ends
+// must share an architecture.
+enum class RolloutMessage : uint16_t {
+    HELLO = 1,     // Worker -> coordinator on connect: uint32 num_envs, observation_size, tiles
+    RESET = 2,     // Restart the slice; no payload
+    STEP = 3,      // uint8 action_type, x, y per env of the slice
+    RESULT = 4,    // float rewards[n], uint8 dones[n], then n compact observations
+    SHUTDOWN = 5   // Worker closes the connection and exits
+};
+
+struct RolloutHeader {
+    static const uint16_t VERSION = 1;
+    static const uint32_t MAX_PAYLOAD = 64 << 20;
+    
+    uint32_t payload_size;
+    uint16_t type;
+    uint16_t version;
+    uint32_t request_id;
+    uint32_t first_env;
+    uint32_t env_count;
+};
+
+// Observations travel with their tile layers (tile types in sevenths and car
+// densities in fifths, both small integers in disguise) as one byte per tile and the remaining
+// features as floats: about a quarter of the raw size, and decoding is exact.
+int compact_observation_size(int observation_size, int tiles);
+void compact_observation(const float* observation, int observation_size, int tiles, uint8_t* out);
+void expand_observation(const uint8_t* compact, int observation_size, int tiles, float* out);
+
+// A socket carrying framed messages, with buffered reads so a burst of small
+// messages costs one read() call
+class RolloutConnection {
+private:
+    int fd;
+    std::vector<uint8_t> read_buffer;
+    size_t read_start;
+    size_t read_end;
+    
+    bool fill(size_t needed);
+
+public:
+    RolloutConnection() : fd(-1), read_start(0), read_end(0) {}
+    explicit RolloutConnection(int socket_fd) : fd(socket_fd), read_start(0), read_end(0) {}
+    ~RolloutConnection();
+    
+    RolloutConnection(const RolloutConnection&) = delete;
+    RolloutConnection& operator=(const RolloutConnection&) = delete;
+    
+    bool connect(const std::string& address);
+    void close();
+    
+    bool send(RolloutMessage type, uint32_t request_id, uint32_t first_env, uint32_t env_count,
+              const void* payload, uint32_t payload_size);
+    // Blocks until a whole message has arrived; false on EOF, error or a bad header
+    bool receive(RolloutHeader& header, std::vector<uint8_t>& payload);
+    // A whole message is already buffered, so receive() will not block
+    bool has_message() const;
+    
+    int get_fd() const { return fd; }
+};
+
+// Listening socket for `address` (a stale unix socket file is replaced); -1 on error
+int listen_on(const std::string& address);
+
+// Serve coordinators one at a time until one sends SHUTDOWN; false if `address`
+// cannot be listened on
+bool run_rollout_worker(const std::string& address, VectorEnv& envs);
+
+// Drives a set of workers. Each worker's envs are split into slices that are
+// stepped independently, so while one slice steps the coordinator can choose
+// actions for another; envs are numbered globally across workers.
+class RolloutCoordinator {
+public:
+    struct Slice {
+        int worker;
+        int first_env;      // Within the worker
+        int global_first;   // Across all workers
+        int count;
+    };
+
+private:
+    std::vector<std::unique_ptr<RolloutConnection>> workers;
+    std::vector<Slice> slices;
+    // Requests in flight per worker as (request_id, slice), answered in send order
+    std::vector<std::deque<std::pair<uint32_t, int>>> pending;
+    int total_envs;
+    int obs_size;
+    int tiles;
+    uint32_t next_request;
+    
+    std::vector<float> observations;
+    std::vector<float> rewards;
+    std::vector<uint8_t> dones;
+    std::vector<uint8_t> message;
+    std::vector<uint8_t> actions;
+    
+    bool send(int slice, RolloutMessage type, const void* payload, uint32_t payload_size);
+
+public:
+    RolloutCoordinator() : total_envs(0), obs_size(0), tiles(0), next_request(0) {}
+    
+    bool connect(const std::vector<std::string>& addresses, int slices_per_worker);
+    
+    bool reset(int slice);
+    // Actions hold ACTION_SIZE values per env of the slice
+    bool step(int slice, const int32_t* actions);
+    // Wait for the next answered request and store its results; the slice index, or -1 on error
+    int receive();
+    void shutdown();
+    
+    int num_envs() const { return total_envs; }
+    int observation_size() const { return obs_size; }
+    int tile_count() const { return tiles; }
+    const std::vector<Slice>& get_slices() const { return slices; }
+    
+    // Latest results, indexed by global env
+    const float* get_observation(int env) const { return &observations[static_cast<size_t>(env) * obs_size]; }
+    float get_reward(int env) const { return rewards[env]; }
+    bool get_done(int env) const { return dones[env] != 0; }
+};
+
+#endif // ROLLOUT_H
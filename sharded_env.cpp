@@ -0,0 +1,100 @@
+#include "sharded_env.h"
+#include "trace.h"
+#include <algorithm>
+
+// ShardedVectorEnv Implementation
+ShardedVectorEnv::ShardedVectorEnv(int num_envs, const Config& config, unsigned base_seed, int num_shards)
+    : nodes(detect_numa_nodes()), body(nullptr), generation(0), running(0), stopping(false) {
+    int total_cpus = 0;
+    for (const NumaNode& node : nodes) {
+        total_cpus += static_cast<int>(node.cpus.size());
+    }
+    if (num_shards <= 0) num_shards = total_cpus;
+    num_shards = std::max(1, std::min(num_shards, num_envs));
+    
+    // Shard i goes to node i % nodes, on that node's next CPU
+    int first_env = 0;
+    for (int i = 0; i < num_shards; i++) {
+        const NumaNode& node = nodes[i % nodes.size()];
+        auto shard = std::make_unique<Shard>();
+        shard->node = node.id;
+        shard->cpu = node.cpus[(i / nodes.size()) % node.cpus.size()];
+        shard->first_env = first_env;
+        shard->num_envs = num_envs / num_shards + (i < num_envs % num_shards ? 1 : 0);
+        first_env += shard->num_envs;
+        shards.push_back(std::move(shard));
+    }
+    
+    // Start states are shared read-only; everything a shard writes is built on its thread
+    std::shared_ptr<const ResetCache> cache = VectorEnv::make_reset_cache(config, base_seed, num_envs);
+    running = num_shards;
+    for (int i = 0; i < num_shards; i++) {
+        shards[i]->thread = std::thread(&ShardedVectorEnv::run_shard, this, i, std::cref(config), base_seed,
+                                        num_envs, cache);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return running == 0; });
+}
+
+ShardedVectorEnv::~ShardedVectorEnv() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start.notify_all();
+    for (auto& shard : shards) {
+        shard->thread.join();
+    }
+}
+
+void ShardedVectorEnv::run_shard(int index, const Config& config, unsigned base_seed, int total_envs,
+                                 std::shared_ptr<const ResetCache> cache) {
+    Shard& shard = *shards[index];
+    pin_current_thread(shard.cpu);
+    trace_set_thread_name("shard " + std::to_string(index) + " (node " + std::to_string(shard.node) + ")");
+    shard.envs = std::make_unique<VectorEnv>(shard.num_envs, config, base_seed, shard.first_env, total_envs,
+                                             std::move(cache));
+    
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (--running == 0) {
+            finished.notify_one();
+        }
+        start.wait(lock, [this, seen]() { return stopping || generation != seen; });
+        if (stopping) break;
+        seen = generation;
+        
+        const ShardBody& current = *body;
+        lock.unlock();
+        {
+            MM_TRACE_SCOPE("shard_body", "shards");
+            current(index, *shard.envs);
+        }
+        lock.lock();
+    }
+}
+
+void ShardedVectorEnv::for_each_shard(const ShardBody& shard_body) {
+    std::unique_lock<std::mutex> lock(mutex);
+    body = &shard_body;
+    running = num_shards();
+    generation++;
+    start.notify_all();
+    finished.wait(lock, [this]() { return running == 0; });
+    body = nullptr;
+}
+
+void ShardedVectorEnv::reset() {
+    for_each_shard([](int, VectorEnv& envs) { envs.reset(); });
+}
+
+void ShardedVectorEnv::step() {
+    for_each_shard([](int, VectorEnv& envs) { envs.step(); });
+}
+
+void ShardedVectorEnv::set_map_bank(std::shared_ptr<const MapBank> bank) {
+    for (auto& shard : shards) {
+        shard->envs->set_map_bank(bank);
+    }
+}
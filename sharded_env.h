@@ -0,0 +1,68 @@
+#ifndef SHARDED_ENV_H
+#define SHARDED_ENV_H
+
+#include "vector_env.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A batch of environments split into shards, each owned by one thread pinned
+// to one CPU. Shards are spread over the NUMA nodes in turn, and every shard
+// thread builds its own VectorEnv, so the envs' grids, cars and buffers are
+// first touched, and therefore placed, on the node that steps them.
+// Seeds follow one VectorEnv of the whole batch (see the partition constructor).
+class ShardedVectorEnv {
+public:
+    using ShardBody = std::function<void(int shard, VectorEnv& envs)>;
+
+private:
+    struct Shard {
+        int node;
+        int cpu;
+        int first_env;
+        int num_envs;
+        std::unique_ptr<VectorEnv> envs;
+        std::thread thread;
+    };
+    
+    std::vector<NumaNode> nodes;
+    std::vector<std::unique_ptr<Shard>> shards;
+    
+    // The body every shard runs next; a new generation starts it
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable finished;
+    const ShardBody* body;
+    uint64_t generation;
+    int running;
+    bool stopping;
+    
+    void run_shard(int index, const Config& config, unsigned base_seed, int total_envs,
+                   std::shared_ptr<const ResetCache> cache);
+
+public:
+    // num_shards <= 0 gives one shard per allowed CPU
+    ShardedVectorEnv(int num_envs, const Config& config, unsigned base_seed = 0, int num_shards = 0);
+    ~ShardedVectorEnv();
+    
+    ShardedVectorEnv(const ShardedVectorEnv&) = delete;
+    ShardedVectorEnv& operator=(const ShardedVectorEnv&) = delete;
+    
+    // Run body on every shard's own thread at once and wait for all of them.
+    // Work that reads or writes a shard's buffers (e.g. policy inference) belongs in here.
+    void for_each_shard(const ShardBody& body);
+    
+    void reset();
+    void step();
+    void set_map_bank(std::shared_ptr<const MapBank> bank);
+    
+    int num_shards() const { return static_cast<int>(shards.size()); }
+    VectorEnv& shard(int index) { return *shards[index]->envs; }
+    int shard_node(int index) const { return shards[index]->node; }
+    int shard_cpu(int index) const { return shards[index]->cpu; }
+    int shard_first_env(int index) const { return shards[index]->first_env; }
+    const std::vector<NumaNode>& get_nodes() const { return nodes; }
+};
+
+#endif // SHARDED_ENV_H
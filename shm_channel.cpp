@@ -0,0 +1,287 @@
+#include "shm_channel.h"
+#include "trace.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+
+namespace {
+
+const int SPIN_ITERATIONS = 256;  // A pause is ~10-140 cycles depending on the CPU
+const int YIELD_ITERATIONS = 100;  // Before falling back to short sleeps (no futex)
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// On a single core the other side cannot run while we spin
+int spin_iterations() {
+    static const int iterations = (std::thread::hardware_concurrency() > 1) ? SPIN_ITERATIONS : 0;
+    return iterations;
+}
+
+size_t align_to_cache_line(size_t offset) {
+    return (offset + 63) & ~static_cast<size_t>(63);
+}
+
+// Only a finished header whose server no longer exists proves a region is
+// abandoned; one still being set up, or a foreign object, is left alone
+bool region_is_stale(const std::string& region_name) {
+    int fd = shm_open(region_name.c_str(), O_RDONLY, 0600);
+    if (fd < 0) return errno == ENOENT;
+    
+    struct stat info;
+    bool stale = false;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(ShmHeader)) {
+        void* data = mmap(nullptr, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            const ShmHeader* h = static_cast<const ShmHeader*>(data);
+            stale = h->magic == ShmHeader::MAGIC && h->server_pid > 0 &&
+                    kill(h->server_pid, 0) != 0 && errno == ESRCH;
+            munmap(data, sizeof(ShmHeader));
+        }
+    }
+    ::close(fd);
+    return stale;
+}
+
+}  // namespace
+
+// Doorbell Implementation
+void Doorbell::ring() {
+    count.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) == 0) return;
+    
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&count), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+bool Doorbell::wait_change(uint32_t seen, int timeout_ms) {
+    for (int i = 0; i < spin_iterations(); i++) {
+        if (count.load(std::memory_order_acquire) != seen) return true;
+        cpu_relax();
+    }
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    bool changed = false;
+    
+    for (int i = 0; ; i++) {
+        if (count.load(std::memory_order_seq_cst) != seen) {
+            changed = true;
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) break;
+        
+#ifdef __linux__
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+        struct timespec timeout;
+        timeout.tv_sec = remaining / 1000000000;
+        timeout.tv_nsec = remaining % 1000000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&count), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+        if (i < YIELD_ITERATIONS) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+#endif
+    }
+    
+    sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    return changed;
+}
+
+// ShmChannel Implementation
+ShmChannel::~ShmChannel() {
+    close();
+}
+
+bool ShmChannel::create(const std::string& region_name, int num_envs, int observation_size,
+                        int action_size) {
+    close();
+    
+    size_t actions_offset = align_to_cache_line(sizeof(ShmHeader));
+    size_t observations_offset = align_to_cache_line(
+        actions_offset + sizeof(int32_t) * num_envs * action_size);
+    size_t rewards_offset = align_to_cache_line(
+        observations_offset + sizeof(float) * static_cast<size_t>(num_envs) * observation_size);
+    size_t dones_offset = align_to_cache_line(rewards_offset + sizeof(float) * num_envs);
+    size_t total_size = align_to_cache_line(dones_offset + num_envs);
+    
+    int fd = shm_open(region_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST && region_is_stale(region_name)) {
+        // A region left behind by a server that crashed is replaced
+        shm_unlink(region_name.c_str());
+        fd = shm_open(region_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        if (errno == EEXIST) {
+            std::cerr << "Shared memory " << region_name << " is in use by another server "
+                      << "(remove /dev/shm" << region_name << " if it is not running)" << std::endl;
+        } else {
+            std::cerr << "Failed to create shared memory " << region_name << ": "
+                      << std::strerror(errno) << std::endl;
+        }
+        return false;
+    }
+    if (ftruncate(fd, total_size) != 0) {
+        std::cerr << "Failed to size shared memory " << region_name << std::endl;
+        ::close(fd);
+        shm_unlink(region_name.c_str());
+        return false;
+    }
+    
+    void* data = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << region_name << std::endl;
+        shm_unlink(region_name.c_str());
+        return false;
+    }
+    
+    name = region_name;
+    base = data;
+    size = total_size;
+    owner = true;
+    last_request = 0;
+    
+    // The new region is zero-filled, which is also the doorbells' starting state
+    ShmHeader* h = header();
+    h->version = ShmHeader::VERSION;
+    h->num_envs = num_envs;
+    h->observation_size = observation_size;
+    h->action_size = action_size;
+    h->command = static_cast<uint32_t>(ShmCommand::NONE);
+    h->server_pid = getpid();
+    h->actions_offset = actions_offset;
+    h->observations_offset = observations_offset;
+    h->rewards_offset = rewards_offset;
+    h->dones_offset = dones_offset;
+    h->total_size = total_size;
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = ShmHeader::MAGIC;
+    return true;
+}
+
+bool ShmChannel::attach(const std::string& region_name) {
+    close();
+    
+    int fd = shm_open(region_name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "No shared memory named " << region_name << " (is the server running?)" << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ShmHeader)) {
+        std::cerr << "Shared memory " << region_name << " is not ready" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    
+    void* data = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << region_name << std::endl;
+        return false;
+    }
+    
+    const ShmHeader* h = static_cast<const ShmHeader*>(data);
+    if (h->magic != ShmHeader::MAGIC || h->version != ShmHeader::VERSION ||
+        h->total_size != static_cast<uint64_t>(info.st_size)) {
+        std::cerr << "Shared memory " << region_name << " is not a version "
+                  << ShmHeader::VERSION << " environment channel" << std::endl;
+        munmap(data, info.st_size);
+        return false;
+    }
+    
+    name = region_name;
+    base = data;
+    size = info.st_size;
+    owner = false;
+    last_request = header()->request.value();
+    return true;
+}
+
+void ShmChannel::close() {
+    if (base) {
+        munmap(base, size);
+        if (owner) {
+            shm_unlink(name.c_str());
+        }
+    }
+    base = nullptr;
+    size = 0;
+    owner = false;
+}
+
+bool ShmChannel::server_alive() const {
+    return kill(header()->server_pid, 0) == 0 || errno == EPERM;
+}
+
+ShmCommand ShmChannel::wait_request(int timeout_ms) {
+    ShmHeader* h = header();
+    if (h->request.value() == last_request && !h->request.wait_change(last_request, timeout_ms)) {
+        return ShmCommand::NONE;
+    }
+    last_request = h->request.value();
+    return static_cast<ShmCommand>(h->command);
+}
+
+void ShmChannel::respond() {
+    header()->response.ring();
+}
+
+bool ShmChannel::call(ShmCommand command) {
+    MM_TRACE_SCOPE("shm_call", "ipc");
+    ShmHeader* h = header();
+    h->command = static_cast<uint32_t>(command);
+    h->request.ring();
+    uint32_t expected = ++last_request;
+    
+    // Responses are counted like requests, so ours is in once the counts match
+    uint32_t seen;
+    while ((seen = h->response.value()) != expected) {
+        if (!h->response.wait_change(seen, 100) && !server_alive()) {
+            std::cerr << "Environment server has exited" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int32_t* ShmChannel::actions() const {
+    return reinterpret_cast<int32_t*>(static_cast<char*>(base) + header()->actions_offset);
+}
+
+float* ShmChannel::observations() const {
+    return reinterpret_cast<float*>(static_cast<char*>(base) + header()->observations_offset);
+}
+
+float* ShmChannel::rewards() const {
+    return reinterpret_cast<float*>(static_cast<char*>(base) + header()->rewards_offset);
+}
+
+uint8_t* ShmChannel::dones() const {
+    return reinterpret_cast<uint8_t*>(static_cast<char*>(base) + header()->dones_offset);
+}
@@ -0,0 +1,102 @@
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A 32-bit counter in shared memory that one side rings and the other waits on.
+// Waiting spins briefly (a round trip is usually a few microseconds), then
+// sleeps on the counter with a futex on Linux, or polls with yields and short
+// sleeps elsewhere. Ringing only makes a wake-up call when someone is asleep.
+struct Doorbell {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sleepers;
+    
+    void ring();
+    uint32_t value() const { return count.load(std::memory_order_acquire); }
+    
+    // Wait until the count no longer reads `seen`; false if `timeout_ms` passed first
+    bool wait_change(uint32_t seen, int timeout_ms);
+};
+
+enum class ShmCommand : uint32_t {
+    NONE = 0,
+    RESET = 1,     // Restart every environment
+    STEP = 2,      // Step every environment with the actions in the region
+    PING = 3,      // No work; measures the round trip
+    SHUTDOWN = 4   // Server answers, then exits
+};
+
+// Region layout: this header, then the action, observation, reward and done
+// arrays at the recorded offsets, each 64-byte aligned. One request is in flight
+// at a time: the client writes the command and actions and rings `request`; the
+// server writes results and rings `response` with the same count. Results stay
+// valid until the next request, so clients read observations in place.
+struct ShmHeader {
+    static const uint32_t MAGIC = 0x4D4D5348;  // "HSMM" in memory
+    static const uint32_t VERSION = 1;
+    
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_envs;
+    uint32_t observation_size;
+    uint32_t action_size;
+    uint32_t command;      // ShmCommand of the pending request
+    int32_t server_pid;
+    uint32_t reserved;
+    uint64_t actions_offset;       // int32_t[num_envs * action_size]
+    uint64_t observations_offset;  // float[num_envs * observation_size]
+    uint64_t rewards_offset;       // float[num_envs]
+    uint64_t dones_offset;         // uint8_t[num_envs]
+    uint64_t total_size;
+    
+    alignas(64) Doorbell request;
+    alignas(64) Doorbell response;
+};
+
+// One side of a shared-memory environment channel. The server creates the
+// region (and removes it when destroyed); one client at a time attaches by name.
+class ShmChannel {
+private:
+    std::string name;
+    void* base;
+    size_t size;
+    bool owner;
+    uint32_t last_request;
+    
+    ShmHeader* header() const { return static_cast<ShmHeader*>(base); }
+    bool server_alive() const;
+    
+public:
+    ShmChannel() : base(nullptr), size(0), owner(false), last_request(0) {}
+    ~ShmChannel();
+    
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+    
+    // Server side
+    bool create(const std::string& region_name, int num_envs, int observation_size, int action_size);
+    // Next request, or NONE when `timeout_ms` passes without one
+    ShmCommand wait_request(int timeout_ms);
+    void respond();
+    
+    // Client side: send a command and block until it is answered.
+    // Returns false if the server has gone away.
+    bool attach(const std::string& region_name);
+    bool call(ShmCommand command);
+    
+    void close();
+    
+    int num_envs() const { return header()->num_envs; }
+    int observation_size() const { return header()->observation_size; }
+    int action_size() const { return header()->action_size; }
+    
+    int32_t* actions() const;
+    float* observations() const;
+    float* rewards() const;
+    uint8_t* dones() const;
+};
+
+#endif // SHM_CHANNEL_H
@@ -0,0 +1,28 @@
+#include "mini_motorways_env.h"
+
+// SpawnScheduler Implementation
+void SpawnScheduler::clear() {
+    for (auto& bucket : buckets) {
+        bucket.clear();
+    }
+}
+
+void SpawnScheduler::schedule(int building_id, int step) {
+    buckets[step & (RING_SIZE - 1)].push_back({step, building_id});
+}
+
+void SpawnScheduler::pop_due(int step, std::vector<int>& due) {
+    due.clear();
+    auto& bucket = buckets[step & (RING_SIZE - 1)];
+    
+    // Keep entries for later laps in place, preserving their order
+    size_t kept = 0;
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i].step == step) {
+            due.push_back(bucket[i].building_id);
+        } else {
+            bucket[kept++] = bucket[i];
+        }
+    }
+    bucket.resize(kept);
+}
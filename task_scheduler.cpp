@@ -0,0 +1,194 @@
+#include "task_scheduler.h"
+#include "cpu_topology.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace {
+
+// Index of the calling thread in the scheduler it works for, -1 elsewhere
+thread_local const TaskScheduler* current_scheduler = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+// TaskScheduler Implementation
+TaskScheduler::TaskScheduler(int num_threads, bool pin_threads)
+    : queued(0), queue_gauge(nullptr), sleepers(0), next_worker(0), stopping(false) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<int> cpus = pin_threads ? allowed_cpus() : std::vector<int>();
+    
+    for (int i = 0; i < num_threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < num_threads; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        threads.emplace_back(&TaskScheduler::run_worker, this, i, cpu);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void TaskScheduler::submit(Task task, Priority priority, TaskGroup* group) {
+    if (group) {
+        group->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    int index = current_scheduler == this ? current_worker
+                                          : static_cast<int>(next_worker++ % workers.size());
+    {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[priority].push_back(Job{std::move(task), group});
+    }
+    
+    // Sleepers re-check `queued` under sleep_mutex after announcing themselves,
+    // so either they see this job or this sees them
+    queued.fetch_add(1);
+    if (queue_gauge) queue_gauge->add(1);
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_one();
+    }
+}
+
+bool TaskScheduler::find_job(int index, Job& job) {
+    if (queued.load(std::memory_order_relaxed) <= 0) return false;
+    
+    int count = static_cast<int>(workers.size());
+    for (int priority = 0; priority < NUM_PRIORITIES; priority++) {
+        // Own deque first, newest job (its data is likely still in cache)
+        {
+            Worker& own = *workers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            std::deque<Job>& queue = own.queues[priority];
+            if (!queue.empty()) {
+                job = std::move(queue.back());
+                queue.pop_back();
+                queued.fetch_sub(1);
+                if (queue_gauge) queue_gauge->add(-1);
+                return true;
+            }
+        }
+        
+        // Then the oldest job of another worker
+        for (int offset = 1; offset < count; offset++) {
+            int victim = (index + offset) % count;
+            Worker& other = *workers[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            std::deque<Job>& queue = other.queues[priority];
+            if (!queue.empty()) {
+                job = std::move(queue.front());
+                queue.pop_front();
+                queued.fetch_sub(1);
+                if (queue_gauge) queue_gauge->add(-1);
+                workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::execute(int index, Job& job) {
+    {
+        MM_TRACE_SCOPE("task", "scheduler");
+        job.task();
+    }
+    job.task = nullptr;  // Release captures before the group can be seen as finished
+    workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+    
+    // Under the group's mutex, so a waiter that sees zero can only return
+    // (and destroy the group) once this thread is done with it
+    TaskGroup* group = job.group;
+    if (group) {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            group->finished.notify_all();
+        }
+    }
+}
+
+void TaskScheduler::run_worker(int index, int cpu) {
+    if (cpu >= 0) {
+        pin_current_thread(cpu);
+    }
+    current_scheduler = this;
+    current_worker = index;
+    trace_set_thread_name("scheduler worker " + std::to_string(index));
+    
+    Job job;
+    while (true) {
+        if (find_job(index, job)) {
+            execute(index, job);
+            continue;
+        }
+        
+        MM_TRACE_SCOPE("idle", "scheduler");
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping && queued.load() == 0) break;
+    }
+}
+
+void TaskScheduler::wait(TaskGroup& group) {
+    if (current_scheduler == this) {
+        // Help rather than block, or a pool whose workers all wait would stall
+        Job job;
+        while (group.pending.load(std::memory_order_acquire) > 0) {
+            if (find_job(current_worker, job)) {
+                execute(current_worker, job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        std::lock_guard<std::mutex> lock(group.mutex);  // See execute()
+        return;
+    }
+    
+    MM_TRACE_SCOPE("group_wait", "scheduler");
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.finished.wait(lock, [&group]() {
+        return group.pending.load(std::memory_order_acquire) == 0;
+    });
+}
+
+void TaskScheduler::parallel_for(int size, int grain, const std::function<void(int first, int count)>& body,
+                                 Priority priority) {
+    grain = std::max(grain, 1);
+    TaskGroup group;
+    for (int first = 0; first < size; first += grain) {
+        int count = std::min(grain, size - first);
+        submit([&body, first, count]() { body(first, count); }, priority, &group);
+    }
+    wait(group);
+}
+
+uint64_t TaskScheduler::get_executed_tasks() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->executed.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t TaskScheduler::get_stolen_tasks() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->stolen.load(std::memory_order_relaxed);
+    }
+    return total;
+}
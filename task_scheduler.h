@@ -0,0 +1,100 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class MetricGauge;
+
+// One pool of worker threads for every kind of task (env stepping, policy
+// inference, ...), so they share the cores instead of each bringing a pool of
+// their own. Each worker has a deque per priority: it pushes and pops its own
+// tasks at the back and, once it runs dry, steals from the front of the others'.
+// A HIGH task anywhere runs before any NORMAL one is started.
+class TaskScheduler {
+public:
+    enum Priority { HIGH = 0, NORMAL = 1, NUM_PRIORITIES = 2 };
+    using Task = std::function<void()>;
+    
+    // Counts a caller's outstanding tasks so it can wait for all of them.
+    // Tasks may submit more tasks to the same group before they finish.
+    class TaskGroup {
+    private:
+        friend class TaskScheduler;
+        std::atomic<int> pending;
+        std::mutex mutex;
+        std::condition_variable finished;
+
+    public:
+        TaskGroup() : pending(0) {}
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+    };
+
+private:
+    struct Job {
+        Task task;
+        TaskGroup* group;
+    };
+    
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Job> queues[NUM_PRIORITIES];
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+    };
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    
+    std::atomic<int> queued;        // Jobs sitting in any deque
+    MetricGauge* queue_gauge;       // Mirrors `queued` for a metrics exporter; not owned
+    std::atomic<int> sleepers;
+    std::atomic<unsigned> next_worker;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping;
+    
+    void run_worker(int index, int cpu);
+    bool find_job(int index, Job& job);
+    void execute(int index, Job& job);
+
+public:
+    // num_threads <= 0 uses every core. With pin_threads, worker i is bound to
+    // the i-th CPU this process may run on (Linux only).
+    explicit TaskScheduler(int num_threads = 0, bool pin_threads = true);
+    ~TaskScheduler();
+    
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    
+    // Queue a task. From a worker it goes on that worker's own deque; from
+    // other threads the deques take turns.
+    void submit(Task task, Priority priority = NORMAL, TaskGroup* group = nullptr);
+    
+    // Block until every task of the group has finished. A worker of this
+    // scheduler runs other tasks meanwhile rather than blocking.
+    void wait(TaskGroup& group);
+    
+    // body(first, count) over [0, size) in pieces of at most grain, then wait
+    void parallel_for(int size, int grain, const std::function<void(int first, int count)>& body,
+                      Priority priority = NORMAL);
+    
+    int size() const { return static_cast<int>(workers.size()); }
+    int get_queued_tasks() const { return queued.load(std::memory_order_relaxed); }
+    // Keep a gauge at the number of queued tasks (null to stop); set while no tasks are in flight.
+    // Each push and pop adds +/-1, so concurrent updates always sum to the true depth.
+    void set_queue_gauge(MetricGauge* gauge) { queue_gauge = gauge; }
+    // Totals over all workers; exact once the scheduler is idle
+    uint64_t get_executed_tasks() const;
+    uint64_t get_stolen_tasks() const;
+};
+
+#endif // TASK_SCHEDULER_H
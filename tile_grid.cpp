@@ -0,0 +1,130 @@
+#include "tile_grid.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Byte -> two unpacked tile values, so a row expands a byte at a time
+struct UnpackTable {
+    float values[256][2];
+
+    UnpackTable() {
+        for (int b = 0; b < 256; b++) {
+            values[b][0] = (b & 0xF) / 7.0f;
+            values[b][1] = (b >> 4) / 7.0f;
+        }
+    }
+};
+
+const UnpackTable& unpack_table() {
+    static const UnpackTable table;
+    return table;
+}
+
+// Expand one packed chunk row (little-endian words: byte i holds tiles 2i and 2i+1)
+void unpack_chunk_row(const uint64_t* row_words, int tiles, float* dst) {
+    const UnpackTable& table = unpack_table();
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row_words);
+    int x = 0;
+    for (; x + 1 < tiles; x += 2) {
+        std::memcpy(dst + x, table.values[bytes[x / 2]], 2 * sizeof(float));
+    }
+    if (x < tiles) {
+        dst[x] = table.values[bytes[x / 2]][0];
+    }
+}
+
+}  // namespace
+
+TileGrid::TileGrid(int width, int height)
+    : grid_width(0), grid_height(0), chunk_cols(0), chunk_rows(0) {
+    resize(width, height);
+}
+
+void TileGrid::resize(int width, int height) {
+    grid_width = width;
+    grid_height = height;
+    chunk_cols = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunk_rows = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    directory.assign(static_cast<size_t>(chunk_cols) * chunk_rows, ChunkEntry{-1, 0});
+    pool.clear();
+    free_slots.clear();
+}
+
+void TileGrid::clear() {
+    for (ChunkEntry& entry : directory) {
+        if (entry.slot >= 0) {
+            release_chunk(entry);
+        }
+    }
+}
+
+int TileGrid::chunk_tile_width(int cx) const {
+    return std::min(CHUNK_SIZE, grid_width - cx * CHUNK_SIZE);
+}
+
+int TileGrid::chunk_tile_height(int cy) const {
+    return std::min(CHUNK_SIZE, grid_height - cy * CHUNK_SIZE);
+}
+
+int TileGrid::allocate_chunk() {
+    int slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = static_cast<int>(pool.size());
+        pool.emplace_back();
+    }
+    std::memset(pool[slot].words, 0, sizeof(pool[slot].words));
+    pool[slot].filled = 0;
+    return slot;
+}
+
+void TileGrid::release_chunk(ChunkEntry& entry) {
+    free_slots.push_back(entry.slot);
+    entry.slot = -1;
+    entry.version++;
+}
+
+void TileGrid::set(int x, int y, TileType tile) {
+    ChunkEntry& entry = directory[(y >> CHUNK_SHIFT) * chunk_cols + (x >> CHUNK_SHIFT)];
+    if (entry.slot < 0) {
+        if (tile == TileType::EMPTY) return;
+        entry.slot = allocate_chunk();
+    }
+
+    Chunk& chunk = pool[entry.slot];
+    uint64_t& word = chunk.words[(y & (CHUNK_SIZE - 1)) * CHUNK_ROW_WORDS +
+                                 ((x & (CHUNK_SIZE - 1)) / TILES_PER_WORD)];
+    int shift = (x % TILES_PER_WORD) * BITS_PER_TILE;
+    TileType previous = static_cast<TileType>((word >> shift) & 0xF);
+    if (previous == tile) return;
+
+    word = (word & ~(0xFULL << shift)) | (static_cast<uint64_t>(tile) << shift);
+
+    chunk.filled += (tile != TileType::EMPTY) - (previous != TileType::EMPTY);
+
+    if (chunk.filled == 0) {
+        release_chunk(entry);
+    } else {
+        entry.version++;
+    }
+}
+
+void TileGrid::unpack_chunk(int cx, int cy, float* out, int stride) const {
+    int tile_w = chunk_tile_width(cx);
+    int tile_h = chunk_tile_height(cy);
+    const uint64_t* words = chunk_words(cx, cy);
+
+    if (!words) {
+        for (int r = 0; r < tile_h; r++) {
+            std::fill(out + r * stride, out + r * stride + tile_w, 0.0f);
+        }
+        return;
+    }
+
+    for (int r = 0; r < tile_h; r++) {
+        unpack_chunk_row(words + r * CHUNK_ROW_WORDS, tile_w, out + r * stride);
+    }
+}
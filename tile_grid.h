@@ -0,0 +1,107 @@
+#ifndef TILE_GRID_H
+#define TILE_GRID_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class TileType : int {
+    EMPTY = 0,
+    HOUSE = 1,
+    BUSINESS = 2,
+    ROAD = 3,
+    MOTORWAY = 4,
+    BRIDGE = 5,
+    ROUNDABOUT = 6,
+    TRAFFIC_LIGHT = 7
+};
+
+// Sparse tile storage: the map is split into 32x32 chunks that are only
+// allocated once they hold a non-EMPTY tile and released when they empty again.
+// Inside a chunk tiles are packed 4 bits each, 16 per 64-bit word, two words per row.
+// Tiles outside the map in edge chunks are always EMPTY.
+// Only the tiles themselves are stored sparsely. The environment's per-tile
+// indexes (free tiles, connectivity labels, flow fields, traffic counters and
+// road occupancy) are dense arrays for O(1) lookups, so total memory still
+// grows with the map's bounding box rather than its built-up area.
+class TileGrid {
+public:
+    static constexpr int BITS_PER_TILE = 4;
+    static constexpr int TILES_PER_WORD = 16;
+    static constexpr int CHUNK_SHIFT = 5;
+    static constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+    static constexpr int CHUNK_ROW_WORDS = CHUNK_SIZE / TILES_PER_WORD;
+    static constexpr int CHUNK_WORDS = CHUNK_SIZE * CHUNK_ROW_WORDS;
+    static constexpr uint64_t NIBBLE_LSB = 0x1111111111111111ULL;
+
+    TileGrid(int width = 0, int height = 0);
+
+    void resize(int width, int height);  // Also clears every tile to EMPTY
+    void clear();
+
+    int width() const { return grid_width; }
+    int height() const { return grid_height; }
+    int chunks_x() const { return chunk_cols; }
+    int chunks_y() const { return chunk_rows; }
+
+    TileType get(int x, int y) const {
+        int slot = directory[(y >> CHUNK_SHIFT) * chunk_cols + (x >> CHUNK_SHIFT)].slot;
+        if (slot < 0) return TileType::EMPTY;
+        uint64_t word = pool[slot].words[(y & (CHUNK_SIZE - 1)) * CHUNK_ROW_WORDS +
+                                         ((x & (CHUNK_SIZE - 1)) / TILES_PER_WORD)];
+        return static_cast<TileType>((word >> ((x % TILES_PER_WORD) * BITS_PER_TILE)) & 0xF);
+    }
+
+    void set(int x, int y, TileType tile);
+
+    // Packed words of a chunk (row r at [r * CHUNK_ROW_WORDS]), or nullptr when unallocated
+    const uint64_t* chunk_words(int cx, int cy) const {
+        int slot = directory[cy * chunk_cols + cx].slot;
+        return slot < 0 ? nullptr : pool[slot].words;
+    }
+
+    // Grows on every change to a chunk (including release), so a reader that
+    // remembers it can skip chunks that have not changed since
+    uint32_t chunk_version(int cx, int cy) const { return directory[cy * chunk_cols + cx].version; }
+
+    // Every tile except EMPTY can be driven through
+    static bool is_passable(TileType tile) { return tile != TileType::EMPTY; }
+    bool is_passable(int x, int y) const { return is_passable(get(x, y)); }
+
+    // One bit per tile (the low bit of its nibble) set for every passable tile in a word
+    static uint64_t passable_nibbles(uint64_t word) {
+        word |= word >> 1;
+        word |= word >> 2;
+        return word & NIBBLE_LSB;
+    }
+
+    // Write one chunk's in-map tiles as values normalised by 1/7. `out` points at
+    // the chunk origin inside a row-major buffer with `stride` floats per row.
+    void unpack_chunk(int cx, int cy, float* out, int stride) const;
+
+private:
+    struct Chunk {
+        uint64_t words[CHUNK_WORDS];
+        int filled;
+    };
+
+    struct ChunkEntry {
+        int slot;
+        uint32_t version;
+    };
+
+    int grid_width;
+    int grid_height;
+    int chunk_cols;
+    int chunk_rows;
+    std::vector<ChunkEntry> directory;
+    std::vector<Chunk> pool;
+    std::vector<int> free_slots;
+
+    int chunk_tile_width(int cx) const;
+    int chunk_tile_height(int cy) const;
+    int allocate_chunk();
+    void release_chunk(ChunkEntry& entry);
+};
+
+#endif // TILE_GRID_H
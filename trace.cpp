@@ -0,0 +1,108 @@
+#include "trace.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+std::atomic<bool> trace_running(false);
+
+namespace {
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> registry;  // Kept after their threads exit
+
+// Where the timeline starts, in trace_clock() ticks and in real time
+uint64_t origin_ticks = 0;
+std::chrono::steady_clock::time_point origin_time;
+
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+}  // namespace
+
+TraceBuffer* trace_register_thread() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(std::make_unique<TraceBuffer>(static_cast<int>(registry.size())));
+    return registry.back().get();
+}
+
+bool trace_start() {
+#ifdef MM_TRACING
+    origin_ticks = trace_clock();
+    origin_time = std::chrono::steady_clock::now();
+    trace_running.store(true);
+    return true;
+#else
+    std::cerr << "Tracing is compiled out; rebuild with -DMM_ENABLE_TRACING=ON" << std::endl;
+    return false;
+#endif
+}
+
+void trace_stop() {
+    trace_running.store(false);
+}
+
+void trace_set_thread_name(const std::string& name) {
+#ifdef MM_TRACING
+    TraceBuffer& buffer = trace_thread_buffer();
+    std::lock_guard<std::mutex> lock(registry_mutex);  // trace_write() may be reading it
+    buffer.thread_name = name;
+#else
+    (void)name;
+#endif
+}
+
+bool trace_write(const std::string& filepath) {
+    std::ofstream out(filepath);
+    if (!out) {
+        std::cerr << "Failed to open trace file: " << filepath << std::endl;
+        return false;
+    }
+    
+    // Ticks per microsecond, measured over the whole trace
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin_time).count();
+    double ticks_per_us = elapsed_us > 0 ? (trace_clock() - origin_ticks) / elapsed_us : 1.0;
+    if (ticks_per_us <= 0) ticks_per_us = 1.0;
+    
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    int pid = static_cast<int>(getpid());
+    uint64_t total = 0;
+    uint64_t dropped = 0;
+    bool first = true;
+    out << "{\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    for (const auto& buffer : registry) {
+        if (!buffer->thread_name.empty()) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->thread_index << ",\"args\":{\"name\":\""
+                << json_escape(buffer->thread_name) << "\"}}";
+            first = false;
+        }
+        
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint64_t i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->chunks[i / TraceBuffer::CHUNK_EVENTS][i % TraceBuffer::CHUNK_EVENTS];
+            if (event.start < origin_ticks) continue;
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                << "\",\"ph\":\"X\",\"ts\":" << (event.start - origin_ticks) / ticks_per_us
+                << ",\"dur\":" << (event.end - event.start) / ticks_per_us << ",\"pid\":" << pid
+                << ",\"tid\":" << buffer->thread_index << "}";
+            first = false;
+        }
+        total += count;
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    
+    if (dropped > 0) {
+        std::cerr << "Trace buffers were full: " << dropped << " events dropped" << std::endl;
+    }
+    return static_cast<bool>(out);
+}
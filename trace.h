@@ -0,0 +1,125 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Scoped trace events for a Chrome / Perfetto timeline (chrome://tracing,
+// ui.perfetto.dev). Built only with -DMM_TRACING (the MM_ENABLE_TRACING CMake
+// option); otherwise MM_TRACE_SCOPE expands to nothing and costs nothing.
+// When built in, a scope costs one relaxed load while no trace is running, and
+// two timestamp reads plus one append to a per-thread buffer (tens of ns) while one is.
+//
+// MM_TRACE_SCOPE marks coarse work: env batches, inference batches, waits and
+// tasks. MM_TRACE_PHASE_SCOPE marks the phases inside one env step and its
+// find_path() calls; at a few microseconds per step those events cost several
+// percent, so they are only built with -DMM_TRACE_STEP_PHASES as well.
+//
+// Names and categories must be string literals (only the pointers are kept).
+#ifdef MM_TRACING
+#define MM_TRACE_CONCAT_INNER(a, b) a##b
+#define MM_TRACE_CONCAT(a, b) MM_TRACE_CONCAT_INNER(a, b)
+#define MM_TRACE_SCOPE(name, category) TraceScope MM_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+#else
+#define MM_TRACE_SCOPE(name, category) ((void)0)
+#endif
+
+#if defined(MM_TRACING) && defined(MM_TRACE_STEP_PHASES)
+#define MM_TRACE_PHASE_SCOPE(name, category) MM_TRACE_SCOPE(name, category)
+#else
+#define MM_TRACE_PHASE_SCOPE(name, category) ((void)0)
+#endif
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t start;  // trace_clock() ticks
+    uint64_t end;
+};
+
+// Events of one thread. Only that thread appends, and each append publishes
+// the new count with a release store, so a writer can read every published
+// event without locks while the thread keeps running.
+class TraceBuffer {
+public:
+    static const int CHUNK_EVENTS = 4096;
+    static const int MAX_CHUNKS = 1024;  // 4M events per thread; later ones are dropped
+
+private:
+    std::unique_ptr<TraceEvent[]> chunks[MAX_CHUNKS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> dropped;
+    int thread_index;
+    std::string thread_name;
+    
+    friend bool trace_write(const std::string& filepath);
+    friend void trace_set_thread_name(const std::string& name);
+
+public:
+    explicit TraceBuffer(int thread_index) : count(0), dropped(0), thread_index(thread_index) {}
+    
+    void append(const char* name, const char* category, uint64_t start, uint64_t end) {
+        uint64_t n = count.load(std::memory_order_relaxed);
+        uint64_t chunk = n / CHUNK_EVENTS;
+        if (chunk >= MAX_CHUNKS) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        if (!chunks[chunk]) chunks[chunk].reset(new TraceEvent[CHUNK_EVENTS]);
+        chunks[chunk][n % CHUNK_EVENTS] = TraceEvent{name, category, start, end};
+        count.store(n + 1, std::memory_order_release);
+    }
+};
+
+extern std::atomic<bool> trace_running;
+
+// The calling thread's buffer, registered on first use
+TraceBuffer* trace_register_thread();
+inline thread_local TraceBuffer* trace_local_buffer = nullptr;
+inline TraceBuffer& trace_thread_buffer() {
+    if (!trace_local_buffer) trace_local_buffer = trace_register_thread();
+    return *trace_local_buffer;
+}
+
+// Cheap timestamps: the TSC on x86 (converted to time when written), steady_clock elsewhere
+inline uint64_t trace_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Start recording; false when built without MM_TRACING
+bool trace_start();
+void trace_stop();
+// Label the calling thread in the timeline, e.g. "scheduler worker 3"
+void trace_set_thread_name(const std::string& name);
+// Every event recorded so far, from all threads, as a Chrome trace JSON file
+bool trace_write(const std::string& filepath);
+
+class TraceScope {
+private:
+    const char* name;
+    const char* category;
+    uint64_t start;
+
+public:
+    TraceScope(const char* name, const char* category)
+        : name(name), category(category),
+          start(trace_running.load(std::memory_order_relaxed) ? trace_clock() : 0) {}
+    ~TraceScope() {
+        if (start) trace_thread_buffer().append(name, category, start, trace_clock());
+    }
+    
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,31 @@
+#include "mini_motorways_env.h"
+#include <cmath>
+
+// TrafficCounters Implementation
+void TrafficCounters::reset(int grid_width, int grid_height) {
+    width = grid_width;
+    current_step = 0;
+    passes.assign(grid_width * grid_height, 0.0f);
+    waits.assign(grid_width * grid_height, 0.0f);
+    last_step.assign(grid_width * grid_height, 0);
+    max_queue.assign(grid_width * grid_height, 0);
+    waiting_now.assign(grid_width * grid_height, 0);
+    wait_step.assign(grid_width * grid_height, -1);
+    
+    if (decay_table.empty()) {
+        decay_table.resize(DECAY_TABLE_SIZE);
+        for (int i = 0; i < DECAY_TABLE_SIZE; i++) {
+            decay_table[i] = std::exp2(-i / HALF_LIFE_STEPS);
+        }
+    }
+}
+
+void TrafficCounters::write_csv(std::ostream& out) const {
+    out << "x,y,passes,waits,max_queue\n";
+    for (int tile = 0; tile < static_cast<int>(passes.size()); tile++) {
+        if (max_queue[tile] == 0 && passes[tile] == 0.0f) continue;
+        out << tile % width << ',' << tile / width << ','
+            << get_passes(tile) << ',' << get_waits(tile) << ','
+            << max_queue[tile] << '\n';
+    }
+}
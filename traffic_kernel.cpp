@@ -0,0 +1,165 @@
+#include "mini_motorways_env.h"
+
+namespace {
+
+// Houses and businesses hold any number of cars; other tiles hold one
+bool holds_one_car(TileType tile) {
+    return tile != TileType::HOUSE && tile != TileType::BUSINESS;
+}
+
+}  // namespace
+
+// NagelSchreckenbergKernel Implementation
+int NagelSchreckenbergKernel::speed_limit(TileType tile) {
+    switch (tile) {
+        case TileType::MOTORWAY:
+            return MAX_VELOCITY;
+        case TileType::ROAD:
+        case TileType::BRIDGE:
+            return 2;
+        default:
+            return 1;  // Buildings and intersections
+    }
+}
+
+int NagelSchreckenbergKernel::free_tiles_ahead(Car& car, int max_gap, const TileGrid& grid,
+                                               IntersectionModel& intersections) {
+    int free = 0;
+    for (int k = 1; k <= max_gap && k < static_cast<int>(car.path.size()); k++) {
+        const Position& pos = car.path[k];
+        if (!grid.is_passable(pos.x, pos.y)) break;
+        if (occupancy[pos.y * grid.width() + pos.x] > 0) break;
+        
+        // Intersections are entered one admission at a time, then the car stops there
+        if (intersections.is_intersection(pos)) {
+            if (k == 1 && car.intersection_clear) {
+                free++;
+            } else if (k == 1) {
+                intersections.request_entry(pos, car.position, &car);
+            }
+            break;
+        }
+        
+        free++;
+        if (pos == car.destination) break;
+    }
+    return free;
+}
+
+int NagelSchreckenbergKernel::step(std::vector<std::shared_ptr<Car>>& cars, const TileGrid& grid,
+                                   IntersectionModel& intersections, TrafficCounters& counters,
+                                   std::mt19937& rng) {
+    int width = grid.width();
+    occupancy.resize(width * grid.height());
+    occupant.resize(width * grid.height());
+    
+    auto occupy = [&](Car* car, int delta) {
+        const Position& pos = car->position;
+        if (holds_one_car(grid.get(pos.x, pos.y))) {
+            int tile = pos.y * width + pos.x;
+            occupancy[tile] += delta;
+            if (delta > 0) {
+                occupant[tile] = car;
+            } else if (occupancy[tile] == 0) {
+                occupant[tile] = nullptr;
+            }
+        }
+    };
+    
+    moving.clear();
+    changed_waits.clear();
+    for (auto& car : cars) {
+        occupy(car.get(), 1);
+        if (!car->completed && car->path.size() > 1) {
+            moving.push_back(car.get());
+        } else {
+            car->waiting_for = nullptr;
+        }
+    }
+    
+    // Gather per-car state into flat arrays
+    int n = moving.size();
+    velocity.resize(n);
+    limit.resize(n);
+    gap.resize(n);
+    dawdle.resize(n);
+    
+    std::uniform_real_distribution<float> dawdle_dist(0.0f, 1.0f);
+    for (int i = 0; i < n; i++) {
+        Car* car = moving[i];
+        velocity[i] = car->velocity;
+        limit[i] = speed_limit(grid.get(car->position.x, car->position.y));
+        gap[i] = free_tiles_ahead(*car, MAX_VELOCITY, grid, intersections);
+        dawdle[i] = dawdle_dist(rng) < DAWDLE_PROBABILITY;
+    }
+    
+    // Accelerate, brake to the gap, dawdle
+    for (int i = 0; i < n; i++) {
+        int v = std::min(velocity[i] + 1, limit[i]);
+        v = std::min(v, gap[i]);
+        velocity[i] = std::max(v - dawdle[i], 0);
+    }
+    
+    // Move, stopping short if a car that merged in earlier this pass took a tile
+    int completed = 0;
+    for (int i = 0; i < n; i++) {
+        Car* car = moving[i];
+        int advanced = 0;
+        
+        while (advanced < velocity[i] && car->path.size() > 1) {
+            Position next_pos = car->path[1];
+            if (holds_one_car(grid.get(next_pos.x, next_pos.y)) &&
+                occupancy[next_pos.y * width + next_pos.x] > 0) break;
+            
+            if (intersections.is_intersection(next_pos)) {
+                car->intersection_clear = false;
+            }
+            occupy(car, -1);
+            car->position = next_pos;
+            car->path.erase(car->path.begin());
+            occupy(car, 1);
+            counters.record_pass(next_pos);
+            advanced++;
+            
+            if (car->position == car->destination) {
+                car->completed = true;
+                completed++;
+                break;
+            }
+        }
+        
+        car->velocity = advanced;
+        if (advanced > 0) {
+            car->stuck_time = 0;
+            car->visual_x += (car->position.x - car->visual_x) * car->speed;
+            car->visual_y += (car->position.y - car->visual_y) * car->speed;
+        } else {
+            car->stuck_time++;
+            counters.record_wait(car->position);
+        }
+    }
+    
+    // Wait-for edges: a car that did not move waits on whoever holds its next tile
+    for (int i = 0; i < n; i++) {
+        Car* car = moving[i];
+        Car* blocker = nullptr;
+        if (velocity[i] == 0 && car->path.size() > 1) {
+            const Position& next_pos = car->path[1];
+            if (holds_one_car(grid.get(next_pos.x, next_pos.y))) {
+                blocker = occupant[next_pos.y * width + next_pos.x];
+            }
+        }
+        if (blocker != car->waiting_for) {
+            car->waiting_for = blocker;
+            if (blocker) {
+                changed_waits.push_back(car);
+            }
+        }
+    }
+    
+    // Leave the occupancy grid zeroed for the next step
+    for (auto& car : cars) {
+        occupy(car.get(), -1);
+    }
+    return completed;
+}
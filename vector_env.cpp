@@ -0,0 +1,136 @@
+#include "vector_env.h"
+#include "trace.h"
+
+// VectorEnv Implementation
+VectorEnv::VectorEnv(int num_envs, const Config& config, unsigned base_seed, const Buffers& external)
+    : num_envs(num_envs), first_env(0), total_envs(num_envs), obs_size(0), mask_sz(0),
+      masks_enabled(external.masks != nullptr), base_seed(base_seed),
+      episode_counts(num_envs, 0), finished_episodes(0), buffers(external) {
+    // The first few episodes of every env have their start maps generated ahead
+    init(config, make_reset_cache(config, base_seed, num_envs));
+}
+
+VectorEnv::VectorEnv(int num_envs, const Config& config, unsigned base_seed, int first_env,
+                     int total_envs, std::shared_ptr<const ResetCache> cache)
+    : num_envs(num_envs), first_env(first_env), total_envs(total_envs), obs_size(0), mask_sz(0),
+      masks_enabled(false), base_seed(base_seed),
+      episode_counts(num_envs, 0), finished_episodes(0) {
+    init(config, std::move(cache));
+}
+
+std::shared_ptr<ResetCache> VectorEnv::make_reset_cache(const Config& config, unsigned base_seed,
+                                                        int total_envs) {
+    MiniMotorwaysEnvironment probe;
+    return std::make_shared<ResetCache>(config, probe.get_grid().width(), probe.get_grid().height(),
+                                        base_seed, total_envs * CACHED_EPISODES_PER_ENV);
+}
+
+void VectorEnv::init(const Config& config, std::shared_ptr<const ResetCache> cache) {
+    for (int i = 0; i < num_envs; i++) {
+        envs.push_back(std::make_unique<MiniMotorwaysEnvironment>());
+        envs.back()->set_config(config);
+        envs.back()->set_reset_cache(cache);
+    }
+    obs_size = envs.front()->get_observation_size();
+    mask_sz = envs.front()->get_action_mask_size();
+    
+    if (!buffers.actions) {
+        owned_actions.assign(num_envs * ACTION_SIZE, 0);
+        buffers.actions = owned_actions.data();
+    }
+    if (!buffers.observations) {
+        owned_observations.assign(static_cast<size_t>(num_envs) * obs_size, 0.0f);
+        buffers.observations = owned_observations.data();
+    }
+    if (!buffers.rewards) {
+        owned_rewards.assign(num_envs, 0.0f);
+        buffers.rewards = owned_rewards.data();
+    }
+    if (!buffers.dones) {
+        owned_dones.assign(num_envs, 0);
+        buffers.dones = owned_dones.data();
+    }
+}
+
+void VectorEnv::set_metrics(EnvMetrics* metrics) {
+    for (auto& env : envs) {
+        env->set_metrics(metrics);
+    }
+}
+
+void VectorEnv::enable_action_masks() {
+    if (!buffers.masks) {
+        owned_masks.assign(static_cast<size_t>(num_envs) * mask_sz, 0);
+        buffers.masks = owned_masks.data();
+    }
+    masks_enabled = true;
+}
+
+void VectorEnv::start_episode(int i) {
+    unsigned index = first_env + i + episode_counts[i]++ * static_cast<unsigned>(total_envs);
+    if (map_bank && map_bank->size() > 0) {
+        envs[i]->set_map_bank(map_bank);
+        envs[i]->reset_to_map(index % map_bank->size());
+    } else {
+        envs[i]->reset(base_seed + index);
+    }
+}
+
+void VectorEnv::write_outputs(int i) {
+    envs[i]->write_observation(buffers.observations + static_cast<size_t>(i) * obs_size);
+    if (masks_enabled) {
+        envs[i]->write_action_mask(buffers.masks + static_cast<size_t>(i) * mask_sz);
+    }
+}
+
+void VectorEnv::reset() {
+    reset(0, num_envs);
+}
+
+void VectorEnv::step() {
+    step(0, num_envs);
+}
+
+void VectorEnv::reset(int first, int count) {
+    MM_TRACE_SCOPE("reset_envs", "env");
+    std::fill(episode_counts.begin() + first, episode_counts.begin() + first + count, 0);
+    for (int i = first; i < first + count; i++) {
+        start_episode(i);
+        write_outputs(i);
+        buffers.rewards[i] = 0.0f;
+        buffers.dones[i] = 0;
+    }
+}
+
+void VectorEnv::reset(TaskScheduler& scheduler, int envs_per_task) {
+    scheduler.parallel_for(num_envs, envs_per_task, [this](int first, int count) { reset(first, count); });
+}
+
+void VectorEnv::step(TaskScheduler& scheduler, int envs_per_task) {
+    scheduler.parallel_for(num_envs, envs_per_task, [this](int first, int count) { step(first, count); });
+}
+
+void VectorEnv::submit_step(TaskScheduler& scheduler, int first, int count, TaskScheduler::TaskGroup* group,
+                            std::function<void()> then) {
+    scheduler.submit([this, first, count, then = std::move(then)]() {
+        step(first, count);
+        if (then) then();
+    }, TaskScheduler::NORMAL, group);
+}
+
+void VectorEnv::step(int first, int count) {
+    MM_TRACE_SCOPE("step_envs", "env");
+    for (int i = first; i < first + count; i++) {
+        MiniMotorwaysEnvironment& env = *envs[i];
+        const int32_t* action = buffers.actions + i * ACTION_SIZE;
+        env.advance(action[0], action[1], action[2]);
+        buffers.rewards[i] = env.get_last_reward();
+        
+        buffers.dones[i] = env.is_done();
+        if (buffers.dones[i]) {
+            finished_episodes.fetch_add(1, std::memory_order_relaxed);
+            start_episode(i);
+        }
+        write_outputs(i);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef VECTOR_ENV_H
+#define VECTOR_ENV_H
+
+#include "mini_motorways_env.h"
+#include "cpu_topology.h"
+#include "task_scheduler.h"
+
+// A batch of headless environments stepped together. Actions, observations,
+// rewards and done flags live in flat buffers (env i's observation starts at
+// observations + i * observation_size()), so a learner can hand over and read
+// back a whole batch at once. An environment that finishes is reset straight
+// away: its done flag is set and its slot holds the next episode's first observation.
+class VectorEnv {
+public:
+    static const int ACTION_SIZE = 3;           // action_type, x, y
+    static const int CACHED_EPISODES_PER_ENV = 16;
+    
+    // Buffers owned by the caller, e.g. inside a shared-memory region.
+    // Members left null are allocated by the VectorEnv.
+    struct Buffers {
+        int32_t* actions;       // num_envs * ACTION_SIZE
+        float* observations;    // num_envs * observation_size()
+        float* rewards;         // num_envs
+        uint8_t* dones;         // num_envs
+        uint8_t* masks;         // num_envs * mask_size(); filled only while masks are enabled
+        
+        Buffers() : actions(nullptr), observations(nullptr), rewards(nullptr), dones(nullptr),
+                    masks(nullptr) {}
+    };
+    
+private:
+    int num_envs;
+    int first_env;
+    int total_envs;
+    int obs_size;
+    int mask_sz;
+    bool masks_enabled;
+    unsigned base_seed;
+    std::vector<std::unique_ptr<MiniMotorwaysEnvironment>> envs;
+    std::vector<unsigned> episode_counts;  // Episodes started per env
+    std::shared_ptr<const MapBank> map_bank;
+    std::atomic<long long> finished_episodes;  // Slices may be stepped from several threads
+    
+    // Owned buffers start on and fill whole cache lines, so batches stepped
+    // from different threads never write to the same line
+    Buffers buffers;
+    CacheAlignedVector<int32_t> owned_actions;
+    CacheAlignedVector<float> owned_observations;
+    CacheAlignedVector<float> owned_rewards;
+    CacheAlignedVector<uint8_t> owned_dones;
+    CacheAlignedVector<uint8_t> owned_masks;
+    
+    void init(const Config& config, std::shared_ptr<const ResetCache> cache);
+    void start_episode(int i);
+    void write_outputs(int i);
+    
+public:
+    // Env i's k-th episode uses seed base_seed + i + k * num_envs, so every
+    // episode in the batch has its own seed and runs are reproducible
+    VectorEnv(int num_envs, const Config& config, unsigned base_seed = 0,
+              const Buffers& external = Buffers());
+    
+    // One part of a batch split across processes: these are envs [first_env,
+    // first_env + num_envs) of total_envs, seeded as if the whole batch were one
+    // VectorEnv. Start states come from `cache` (see make_reset_cache()), or are
+    // generated at each reset when it is null.
+    VectorEnv(int num_envs, const Config& config, unsigned base_seed, int first_env, int total_envs,
+              std::shared_ptr<const ResetCache> cache);
+    
+    // Start states for the first episodes of a whole batch of total_envs
+    static std::shared_ptr<ResetCache> make_reset_cache(const Config& config, unsigned base_seed,
+                                                        int total_envs);
+    
+    // Start episode k of env i from map (first_env + i + k * total_envs) % size of the bank instead
+    void set_map_bank(std::shared_ptr<const MapBank> bank) { map_bank = std::move(bank); }
+    // Feed every env's steps, episodes and stuck cars into shared metrics (null to stop)
+    void set_metrics(EnvMetrics* metrics);
+    
+    // Also write each env's action mask (see write_action_mask()) after every reset
+    // and step. On from the start when the caller supplies a mask buffer.
+    void enable_action_masks();
+    
+    void reset();  // Restart every env and clear the done flags
+    void step();   // Apply the actions in the buffer to every env
+    
+    // The same for envs [first, first + count) only, e.g. one slice of a pipelined
+    // batch. Slices that do not overlap may be reset and stepped concurrently.
+    void reset(int first, int count);
+    void step(int first, int count);
+    
+    // Reset or step the whole batch as tasks of envs_per_task envs on a shared
+    // scheduler, returning once every slice is done
+    void reset(TaskScheduler& scheduler, int envs_per_task);
+    void step(TaskScheduler& scheduler, int envs_per_task);
+    // Queue a NORMAL task that steps envs [first, first + count) and then calls
+    // `then` (if set) on the same worker, e.g. to queue inference for the slice
+    void submit_step(TaskScheduler& scheduler, int first, int count, TaskScheduler::TaskGroup* group,
+                     std::function<void()> then = nullptr);
+    
+    int size() const { return num_envs; }
+    int observation_size() const { return obs_size; }
+    int mask_size() const { return mask_sz; }
+    long long get_finished_episodes() const { return finished_episodes.load(std::memory_order_relaxed); }
+    
+    int32_t* actions() { return buffers.actions; }
+    const float* observations() const { return buffers.observations; }
+    const float* rewards() const { return buffers.rewards; }
+    const uint8_t* dones() const { return buffers.dones; }
+    const uint8_t* masks() const { return buffers.masks; }
+    const Buffers& get_buffers() const { return buffers; }
+    
+    MiniMotorwaysEnvironment& env(int i) { return *envs[i]; }
+};
+
+#endif // VECTOR_ENV_H